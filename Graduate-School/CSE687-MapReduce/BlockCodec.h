@@ -0,0 +1,238 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// Block compression for intermediate files, self-contained so the tree has
+// no external dependency. The LZ4 codec produces the standard LZ4 block
+// format (token, literals, 16-bit offset, match length; last 5 bytes always
+// literals) with a greedy single-probe hash matcher, which favours speed
+// over ratio. Word-count spills of the sample inputs shrink only about
+// 1.2-1.45x: each key appears once per spill, so there is little to match.
+//
+// Compressed files are a header followed by frames:
+//
+//     header: 0x80 0x00 'M' 'R' 'Z' codec
+//     frame:  varint(raw size) | varint(stored size) | stored bytes
+//
+// A frame whose stored size equals its raw size holds the bytes
+// uncompressed. 0x80 0x00 is an over-long varint that RecordWriter never
+// emits, so a reader can tell a compressed file from a plain record file by
+// its first bytes.
+class BlockCodec {
+public:
+    enum class Codec : uint8_t { None = 0, LZ4 = 1 };
+
+    static constexpr char kMagic[6] = {'\x80', '\x00', 'M', 'R', 'Z', '\x01'};
+    static constexpr size_t kMagicBytes = sizeof(kMagic);
+
+    // "none" / "lz4"; anything else leaves codec unchanged and returns false.
+    static bool parse(std::string_view name, Codec& codec) {
+        if (name == "none") {
+            codec = Codec::None;
+            return true;
+        }
+        if (name == "lz4") {
+            codec = Codec::LZ4;
+            return true;
+        }
+        return false;
+    }
+
+    static const char* name(Codec codec) {
+        return codec == Codec::LZ4 ? "lz4" : "none";
+    }
+
+    static bool is_compressed_header(const char* data, size_t size) {
+        return size >= kMagicBytes && std::memcmp(data, kMagic, kMagicBytes) == 0;
+    }
+
+    static size_t compress_bound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // Appends one frame holding src to out.
+    static void append_frame(std::string& out, const char* src, size_t size) {
+        thread_local std::string compressed;
+        if (compressed.size() < compress_bound(size)) {
+            compressed.resize(compress_bound(size));
+        }
+        size_t stored = compress(src, size, &compressed[0]);
+        append_varint(out, size);
+        if (stored >= size) {
+            append_varint(out, size);
+            out.append(src, size);
+        } else {
+            append_varint(out, stored);
+            out.append(compressed.data(), stored);
+        }
+    }
+
+    // LZ4 block compression of src into dst (at least compress_bound(size)
+    // bytes). Returns the compressed size.
+    static size_t compress(const char* src, size_t size, char* dst) {
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+        uint8_t* op = out;
+        size_t anchor = 0;
+
+        if (size >= kMinInput) {
+            thread_local std::vector<uint32_t> table;
+            table.assign(size_t(1) << kHashBits, 0);
+            size_t matchLimit = size - kLastLiterals;
+            size_t inputLimit = size - kMatchFindLimit;
+            size_t ip = 1;
+            table[hash(read32(in))] = 0;
+            while (ip < inputLimit) {
+                uint32_t sequence = read32(in + ip);
+                uint32_t h = hash(sequence);
+                size_t ref = table[h];
+                table[h] = static_cast<uint32_t>(ip);
+                if (ref >= ip || ip - ref > kMaxOffset || read32(in + ref) != sequence) {
+                    // Skip faster through incompressible stretches
+                    ip += 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+                size_t length = kMinMatch;
+                while (ip + length < matchLimit && in[ref + length] == in[ip + length]) {
+                    ++length;
+                }
+                op = write_sequence(op, in + anchor, ip - anchor, static_cast<uint16_t>(ip - ref), length);
+                ip += length;
+                anchor = ip;
+                if (ip < inputLimit) {
+                    table[hash(read32(in + ip - 2))] = static_cast<uint32_t>(ip - 2);
+                }
+            }
+        }
+
+        // Last literals
+        size_t literals = size - anchor;
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((literals >= 15 ? 15 : literals) << 4);
+        op = write_length(op, literals);
+        std::memcpy(op, in + anchor, literals);
+        op += literals;
+        return static_cast<size_t>(op - out);
+    }
+
+    // Decodes an LZ4 block into exactly rawSize bytes at dst. Returns false
+    // on malformed input instead of reading or writing out of bounds.
+    static bool decompress(const char* src, size_t size, char* dst, size_t rawSize) {
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+        const uint8_t* end = ip + size;
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+        size_t op = 0;
+
+        while (ip < end) {
+            uint8_t token = *ip++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !read_length(ip, end, literals)) {
+                return false;
+            }
+            if (static_cast<size_t>(end - ip) < literals || rawSize - op < literals) {
+                return false;
+            }
+            std::memcpy(out + op, ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == end) {
+                break;
+            }
+
+            if (end - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > op) {
+                return false;
+            }
+            size_t length = token & 15;
+            if (length == 15 && !read_length(ip, end, length)) {
+                return false;
+            }
+            length += kMinMatch;
+            if (rawSize - op < length) {
+                return false;
+            }
+            uint8_t* match = out + op - offset;
+            if (offset >= length) {
+                std::memcpy(out + op, match, length);
+            } else {
+                for (size_t i = 0; i < length; ++i) {
+                    out[op + i] = match[i];
+                }
+            }
+            op += length;
+        }
+        return op == rawSize;
+    }
+
+private:
+    static constexpr size_t kMinMatch = 4;
+    static constexpr size_t kLastLiterals = 5;
+    static constexpr size_t kMatchFindLimit = 12;
+    static constexpr size_t kMinInput = kMatchFindLimit + 1;
+    static constexpr size_t kMaxOffset = 65535;
+    static constexpr unsigned kHashBits = 14;
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - kHashBits);
+    }
+
+    static void append_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static uint8_t* write_length(uint8_t* op, size_t length) {
+        if (length < 15) {
+            return op;
+        }
+        length -= 15;
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    static bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+        uint8_t byte;
+        do {
+            if (ip == end) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    static uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, size_t literalCount,
+                                   uint16_t offset, size_t matchLength) {
+        uint8_t* token = op++;
+        size_t matchCode = matchLength - kMinMatch;
+        *token = static_cast<uint8_t>(((literalCount >= 15 ? 15 : literalCount) << 4) |
+                                      (matchCode >= 15 ? 15 : matchCode));
+        op = write_length(op, literalCount);
+        std::memcpy(op, literals, literalCount);
+        op += literalCount;
+        *op++ = static_cast<uint8_t>(offset & 0xFF);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        return write_length(op, matchCode);
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer / multi-consumer queue connecting pipeline stages.
+//
+// The ring buffer follows Dmitry Vyukov's design: every cell carries a
+// sequence number that tells producers and consumers whether it is free or
+// full for the current lap, so try_push/try_pop are a single CAS on the
+// shared position plus one release store, with no lock. The fixed capacity
+// is what bounds memory in pipelined mode: a fast stage blocks in push()
+// once its downstream queue is full.
+//
+// push()/pop() wait with spin-then-sleep backoff. close() marks the end of
+// the stream and must only be called after every producer has returned from
+// its last push(); pop() then drains what is left and returns false.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool try_push(T& item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(item);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& item) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(cell.data);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T item) {
+        for (unsigned attempt = 0; !try_push(item); ++attempt) {
+            backoff(attempt);
+        }
+    }
+
+    // Returns false once the queue is closed and empty.
+    bool pop(T& item) {
+        for (unsigned attempt = 0;; ++attempt) {
+            if (try_pop(item)) {
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                return try_pop(item);
+            }
+            backoff(attempt);
+        }
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Approximate; only for instrumentation.
+    size_t size_approx() const {
+        size_t tail = dequeuePos.load(std::memory_order_relaxed);
+        size_t head = enqueuePos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static void backoff(unsigned attempt) {
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+    alignas(64) std::atomic<bool> closed{false};
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <memory_resource>
+#include <algorithm>
+#include <cstdint>
+#include "Hash.h"
+#include "StringPool.h"
+
+// Map-side combiner: a bounded open-addressing table of partial counts that
+// sits between a mapper and its spill. Repeated keys are summed in place, so
+// what reaches the spill is one record per distinct word rather than one per
+// token. When the table holds maxEntries distinct keys it hands its contents
+// to the sink and starts over, which bounds memory per map task regardless of
+// vocabulary size. Call flush() once the input is done; the destructor does
+// not, so the sink never runs against a half torn-down caller.
+//
+// Entries live in a dense vector of (key, count) pairs; the probe table only
+// stores indexes into it. Iterating a Combiner therefore walks the pairs
+// exactly like a std::map, which is what PartitionedSpill::spill expects.
+// Key bytes go to a StringPool, so a flush releases all of them at once.
+// The fixed-size table (probe slots, hashes, entries) comes from resource,
+// normally the map task's TaskArena, and a Combiner must not outlive it.
+// Key bytes stay on the default heap: every flush frees them, and a
+// monotonic arena would keep each flush's keys until the task ends.
+class Combiner {
+public:
+    using Entry = std::pair<std::string_view, uint64_t>;
+    using Sink = std::function<void(const Combiner&)>;
+
+    static constexpr size_t kDefaultEntries = 1 << 16;
+
+    explicit Combiner(Sink sink, size_t maxEntries = kDefaultEntries,
+                      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : sink(std::move(sink)), maxEntries(maxEntries > 0 ? maxEntries : 1),
+          slots(resource), hashes(resource), entries(resource), keys(kKeyBlockBytes) {
+        // Keep the load factor at or below 1/2 so probe runs stay short
+        size_t capacity = 16;
+        while (capacity < this->maxEntries * 2) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, 0);
+        hashes.reserve(this->maxEntries);
+        entries.reserve(this->maxEntries);
+    }
+
+    Combiner(const Combiner&) = delete;
+    Combiner& operator=(const Combiner&) = delete;
+
+    void add(std::string_view key, uint64_t count = 1) {
+        uint64_t hash = Hash::mix(Hash::fnv1a(key));
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (slots[slot] != 0) {
+            size_t index = slots[slot] - 1;
+            if (hashes[index] == hash && entries[index].first == key) {
+                entries[index].second += count;
+                return;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        if (entries.size() == maxEntries) {
+            flush();
+            add(key, count);
+            return;
+        }
+        entries.emplace_back(keys.intern(key), count);
+        hashes.push_back(hash);
+        slots[slot] = static_cast<uint32_t>(entries.size());
+    }
+
+    // Passes any buffered partial counts to the sink and empties the table.
+    void flush() {
+        if (entries.empty()) {
+            return;
+        }
+        if (sink) {
+            sink(*this);
+        }
+        ++flushes;
+        clear();
+    }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), 0);
+        hashes.clear();
+        entries.clear();
+        keys.clear();
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    size_t flush_count() const { return flushes; }
+
+    std::pmr::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+    std::pmr::vector<Entry>::const_iterator end() const { return entries.end(); }
+
+private:
+    static constexpr size_t kKeyBlockBytes = 64 * 1024;
+
+    Sink sink;
+    size_t maxEntries;
+    size_t flushes = 0;
+    std::pmr::vector<uint32_t> slots;
+    std::pmr::vector<uint64_t> hashes;
+    std::pmr::vector<Entry> entries;
+    StringPool keys;
+};
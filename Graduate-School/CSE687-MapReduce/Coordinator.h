@@ -0,0 +1,647 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include "ERROR_Handler.h"
+#include "Combiner.h"
+#include "FlatStringMap.h"
+#include "Hash.h"
+#include "InputSplit.h"
+#include "JobKernel.h"
+#include "JobManifest.h"
+#include "KernelLibrary.h"
+#include "MappedFile.h"
+#include "Mapper.h"
+#include "PartitionedSpill.h"
+#include "RecordIO.h"
+#include "TaskArena.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Multi-process execution mode. The coordinator (the driver process) forks
+// N worker processes, each connected to it by a Unix domain socket pair,
+// and hands out tasks one at a time:
+//
+//   map task t     split t  -> <temp>/map_<t>_<p>.bin for every partition p
+//   reduce task p  <temp>/map_*_<p>.bin -> <temp>/reduce_<p>.bin
+//
+// All reduce tasks start after the last map task has finished. Workers
+// inherit the planned splits through fork(), so a task message is only
+// (type, id, attempt) and a reply is (id, ok). Every task rewrites its
+// output files from scratch, which makes re-running one safe: a task that
+// reports failure is re-queued, and a worker that dies mid-task is reaped,
+// replaced, and its task re-queued, up to maxAttempts per task.
+//
+// With resume, the driver keeps a JobManifest in the temp folder: each
+// worker hashes the files its task wrote and the driver logs them as the
+// task completes. A rerun of the same job skips every task whose files are
+// intact and starts at the first one that is not. Reduce tasks are only
+// skipped when no map task has to run again.
+//
+// Workers run tasks single-threaded in their own address space and never
+// touch the driver's ThreadPool or Logger, whose threads do not exist after
+// fork(). With pinWorkers, worker i is bound to the CPUs of NUMA node
+// i % nodes (read from sysfs; no libnuma needed).
+class Coordinator {
+public:
+    struct Options {
+        size_t workers = 0;         // 0 = hardware_concurrency
+        size_t maxAttempts = 3;     // failed runs allowed per task
+        bool pinWorkers = false;
+        const mr_kernel* kernel = nullptr;
+        bool resume = false;        // checkpoint tasks in a JobManifest and skip finished ones
+        long crashTask = -1;        // tests: first run of this map task kills its worker
+        long crashPartition = -1;   // tests: first run of this reduce task kills its worker
+    };
+
+    Coordinator() : Coordinator(Options()) {}
+
+    explicit Coordinator(Options options)
+        : options(options) {
+        if (this->options.workers == 0) {
+            size_t hw = std::thread::hardware_concurrency();
+            this->options.workers = hw > 0 ? hw : 2;
+        }
+        if (this->options.maxAttempts == 0) {
+            this->options.maxAttempts = 1;
+        }
+    }
+
+    // Runs map and reduce over the splits in worker processes and merges the
+    // per-partition results into result.
+    bool run(const std::vector<InputSplit>& splits, const std::string& tempFolder, size_t numPartitions,
+             FlatStringMap<uint64_t>& result) {
+#ifdef _WIN32
+        (void)splits; (void)tempFolder; (void)numPartitions; (void)result;
+        ErrorHandler::reportError("Multi-process mode needs fork() and Unix domain sockets.");
+        return false;
+#else
+        if (numPartitions == 0) {
+            numPartitions = 1;
+        }
+        job = Job{&splits, tempFolder, numPartitions};
+        restartCount = 0;
+        resumedCount = 0;
+        cpuSets = options.pinWorkers ? numa_cpu_sets() : std::vector<std::vector<int>>();
+
+        // Finished tasks of an earlier run, checked before any worker is
+        // forked
+        std::vector<char> mapDone(splits.size(), 0);
+        std::vector<char> reduceDone(numPartitions, 0);
+        JobManifest manifest(tempFolder);
+        if (options.resume) {
+            manifest.open(plan_hash(splits, numPartitions));
+            mapDone = manifest.verify("map", splits.size());
+            if (std::find(mapDone.begin(), mapDone.end(), 0) == mapDone.end()) {
+                reduceDone = manifest.verify("reduce", numPartitions);
+            } else {
+                manifest.forget("reduce");
+            }
+            if (!manifest.start()) {
+                return false;
+            }
+            resumedCount = static_cast<size_t>(std::count(mapDone.begin(), mapDone.end(), 1) +
+                                               std::count(reduceDone.begin(), reduceDone.end(), 1));
+        }
+
+        for (size_t i = 0; i < options.workers; ++i) {
+            if (!spawn_worker(i)) {
+                stop_workers();
+                return false;
+            }
+        }
+
+        std::vector<Task> mapTasks;
+        for (size_t t = 0; t < splits.size(); ++t) {
+            if (!mapDone[t]) {
+                mapTasks.push_back(Task{kMapTask, t, 0});
+            }
+        }
+        std::vector<Task> reduceTasks;
+        for (size_t p = 0; p < numPartitions; ++p) {
+            if (!reduceDone[p]) {
+                reduceTasks.push_back(Task{kReduceTask, p, 0});
+            }
+        }
+        JobManifest* checkpoint = options.resume ? &manifest : nullptr;
+        bool ok = run_phase(mapTasks, checkpoint) && run_phase(reduceTasks, checkpoint);
+        stop_workers();
+        if (!ok) {
+            return false;
+        }
+
+        result.clear();
+        for (size_t p = 0; p < numPartitions; ++p) {
+            RecordReader reader;
+            if (!reader.open(reduce_output_path(tempFolder, p))) {
+                return false;
+            }
+            std::string_view key;
+            uint64_t count;
+            while (reader.next(key, count)) {
+                result[key] += count;
+            }
+            if (reader.truncated()) {
+                ErrorHandler::reportError("File " + reduce_output_path(tempFolder, p) + " ends in the middle of a record.");
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    // Workers that had to be replaced during the last run.
+    size_t restarts() const {
+        return restartCount;
+    }
+
+    // Tasks the last run skipped because an earlier run had finished them.
+    size_t resumed_tasks() const {
+        return resumedCount;
+    }
+
+    const Options& get_options() const {
+        return options;
+    }
+
+    static std::string map_output_base(const std::string& tempFolder, size_t taskId) {
+        return tempFolder + "/map_" + std::to_string(taskId);
+    }
+
+    static std::string reduce_output_path(const std::string& tempFolder, size_t partition) {
+        return tempFolder + "/reduce_" + std::to_string(partition) + ".bin";
+    }
+
+    // Files a task writes, in the order their checks are sent back.
+    static std::vector<std::string> task_outputs(bool map, size_t id, const std::string& tempFolder,
+                                                 size_t numPartitions) {
+        if (map) {
+            return PartitionedSpill::spill_paths(map_output_base(tempFolder, id), numPartitions);
+        }
+        return {reduce_output_path(tempFolder, id)};
+    }
+
+    // Map task body: one split into one spill file per partition.
+    static bool run_map_task(const InputSplit& split, size_t taskId, const std::string& tempFolder,
+                             size_t numPartitions, const mr_kernel* kernel) {
+        MappedFile file;
+        if (!file.open(split.path)) {
+            return false;
+        }
+        PartitionedSpill spill(PartitionedSpill::spill_paths(map_output_base(tempFolder, taskId), numPartitions));
+        if (!spill.open()) {
+            return false;
+        }
+        TaskArena arena;
+        Combiner combiner([&spill](const Combiner& partial) { spill.spill(partial); }, Combiner::kDefaultEntries,
+                          arena.resource());
+        std::string_view text = MappedFile::line_range(file.view(), split.offset, split.length);
+        bool ok = true;
+        if (kernel != nullptr) {
+            ok = Mapper::map_kernel(*kernel, text, combiner);
+        } else {
+            std::pmr::string scratch(arena.resource());
+            Mapper::map_text(text, combiner, scratch);
+        }
+        combiner.flush();
+        return spill.close() && ok;
+    }
+
+    // Reduce task body: every map task's spill file for one partition.
+    static bool run_reduce_task(size_t partition, size_t numMapTasks, const std::string& tempFolder,
+                                const mr_kernel* kernel) {
+        FlatStringMap<uint64_t> table;
+        FlatStringMap<std::vector<uint64_t>> groups;
+        for (size_t t = 0; t < numMapTasks; ++t) {
+            std::string path = map_output_base(tempFolder, t) + "_" + std::to_string(partition) + ".bin";
+            RecordReader reader;
+            if (!reader.open(path)) {
+                return false;
+            }
+            std::string_view key;
+            uint64_t count;
+            while (reader.next(key, count)) {
+                if (kernel != nullptr) {
+                    groups[key].push_back(count);
+                } else {
+                    table[key] += count;
+                }
+            }
+            if (reader.truncated()) {
+                ErrorHandler::reportError("File " + path + " ends in the middle of a record.");
+                return false;
+            }
+        }
+        if (kernel != nullptr && !KernelLibrary::reduce_groups(*kernel, groups, table)) {
+            return false;
+        }
+
+        RecordWriter out;
+        if (!out.open(reduce_output_path(tempFolder, partition))) {
+            return false;
+        }
+        for (const auto& kv : table) {
+            out.write(kv.first, static_cast<uint64_t>(kv.second));
+        }
+        return out.close();
+    }
+
+private:
+    enum : uint8_t { kMapTask = 1, kReduceTask = 2, kExit = 3 };
+
+#if defined(MSG_NOSIGNAL)
+    // A dead worker must show up as a failed send, not as SIGPIPE
+    static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int kSendFlags = 0;
+#endif
+
+    struct Task {
+        uint8_t type;
+        size_t id;
+        size_t failures;
+    };
+
+    struct Job {
+        const std::vector<InputSplit>* splits = nullptr;
+        std::string tempFolder;
+        size_t numPartitions = 1;
+    };
+
+#ifndef _WIN32
+    struct Worker {
+        pid_t pid = -1;
+        int fd = -1;
+        bool busy = false;
+        size_t task = 0;   // index into the current phase's tasks
+    };
+
+    // Hands out tasks until every task of the phase has succeeded, logging
+    // each to checkpoint if there is one. Returns false once a task has
+    // failed maxAttempts times or no worker is left.
+    bool run_phase(std::vector<Task>& tasks, JobManifest* checkpoint) {
+        std::deque<size_t> queue;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            queue.push_back(i);
+        }
+        size_t done = 0;
+
+        while (done < tasks.size()) {
+            for (size_t w = 0; w < workers.size() && !queue.empty(); ++w) {
+                Worker& worker = workers[w];
+                if (worker.fd < 0 || worker.busy) {
+                    continue;
+                }
+                size_t index = queue.front();
+                std::string message;
+                message += static_cast<char>(tasks[index].type);
+                RecordWriter::append_varint(message, tasks[index].id);
+                RecordWriter::append_varint(message, tasks[index].failures);
+                if (!write_frame(worker.fd, message)) {
+                    if (!replace_worker(w)) {
+                        return false;
+                    }
+                    continue;
+                }
+                queue.pop_front();
+                worker.busy = true;
+                worker.task = index;
+            }
+
+            std::vector<pollfd> fds;
+            std::vector<size_t> owners;
+            for (size_t w = 0; w < workers.size(); ++w) {
+                if (workers[w].fd >= 0 && workers[w].busy) {
+                    fds.push_back(pollfd{workers[w].fd, POLLIN, 0});
+                    owners.push_back(w);
+                }
+            }
+            if (fds.empty()) {
+                ErrorHandler::reportError("No worker processes left to run tasks.");
+                return false;
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ErrorHandler::reportError(std::string("poll failed: ") + std::strerror(errno));
+                return false;
+            }
+
+            for (size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents == 0) {
+                    continue;
+                }
+                size_t w = owners[i];
+                size_t index = workers[w].task;
+                std::string reply;
+                uint64_t id = 0;
+                bool succeeded = false;
+                bool alive = read_frame(workers[w].fd, reply);
+                const char* pos = reply.data();
+                const char* end = pos + reply.size();
+                if (alive) {
+                    alive = RecordReader::read_varint(pos, end, id) && pos < end && id == tasks[index].id;
+                    succeeded = alive && *pos++ == 1;
+                }
+                workers[w].busy = false;
+                if (succeeded && checkpoint != nullptr && !record_task(*checkpoint, tasks[index], pos, end)) {
+                    return false;
+                }
+                if (succeeded) {
+                    ++done;
+                    continue;
+                }
+                if (!alive) {
+                    ErrorHandler::reportError("Worker " + std::to_string(workers[w].pid) + " exited during " +
+                                              task_name(tasks[index]) + "; re-running it.");
+                    if (!replace_worker(w)) {
+                        return false;
+                    }
+                }
+                if (++tasks[index].failures >= options.maxAttempts) {
+                    ErrorHandler::reportError(task_name(tasks[index]) + " failed " +
+                                              std::to_string(tasks[index].failures) + " times.");
+                    return false;
+                }
+                queue.push_back(index);
+            }
+        }
+        return true;
+    }
+
+    // Logs a finished task with the file checks that follow its reply.
+    bool record_task(JobManifest& checkpoint, const Task& task, const char* pos, const char* end) const {
+        std::vector<std::string> outputs = task_outputs(task.type == kMapTask, task.id, job.tempFolder, job.numPartitions);
+        std::vector<std::pair<std::string, JobManifest::FileCheck>> files;
+        for (const std::string& output : outputs) {
+            JobManifest::FileCheck file;
+            if (!RecordReader::read_varint(pos, end, file.size) || !RecordReader::read_varint(pos, end, file.hash)) {
+                ErrorHandler::reportError(task_name(task) + " sent back no file checks.");
+                return false;
+            }
+            files.emplace_back(std::filesystem::path(output).filename().string(), file);
+        }
+        return checkpoint.record(task.type == kMapTask ? "map" : "reduce", task.id, std::move(files));
+    }
+
+    // Hash of everything that decides what the tasks write: the splits and
+    // the size and mtime of their files, the partition count, the kernel and
+    // the codec. A manifest from a different plan is not trusted.
+    uint64_t plan_hash(const std::vector<InputSplit>& splits, size_t numPartitions) const {
+        std::ostringstream plan;
+        plan << numPartitions << ' ' << (options.kernel != nullptr ? options.kernel->name : "builtin") << ' '
+             << static_cast<int>(RecordWriter::default_codec()) << '\n';
+        for (const InputSplit& split : splits) {
+            std::error_code sizeError;
+            std::error_code timeError;
+            uint64_t size = std::filesystem::file_size(split.path, sizeError);
+            auto modified = std::filesystem::last_write_time(split.path, timeError);
+            plan << split.path << '\n' << split.offset << ' ' << split.length << ' ' << (sizeError ? 0 : size) << ' '
+                 << (timeError ? 0 : modified.time_since_epoch().count()) << '\n';
+        }
+        return Hash::content(plan.str());
+    }
+
+    bool spawn_worker(size_t slot) {
+        int sockets[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            ErrorHandler::reportError(std::string("socketpair failed: ") + std::strerror(errno));
+            return false;
+        }
+        pid_t pid = ::fork();
+        if (pid < 0) {
+            ErrorHandler::reportError(std::string("fork failed: ") + std::strerror(errno));
+            ::close(sockets[0]);
+            ::close(sockets[1]);
+            return false;
+        }
+        if (pid == 0) {
+            ::close(sockets[0]);
+            for (const Worker& other : workers) {
+                if (other.fd >= 0) {
+                    ::close(other.fd);
+                }
+            }
+            if (!cpuSets.empty()) {
+                pin_to(cpuSets[slot % cpuSets.size()]);
+            }
+            worker_main(sockets[1]);
+        }
+        ::close(sockets[1]);
+        if (workers.size() <= slot) {
+            workers.resize(slot + 1);
+        }
+        workers[slot] = Worker{pid, sockets[0], false, 0};
+        return true;
+    }
+
+    // Reaps a dead worker and forks a replacement in the same slot. The
+    // number of replacements per run is bounded so a worker that dies on
+    // start-up cannot loop forever.
+    bool replace_worker(size_t slot) {
+        Worker& worker = workers[slot];
+        ::close(worker.fd);
+        worker.fd = -1;
+        int status;
+        ::waitpid(worker.pid, &status, 0);
+        if (restartCount >= options.workers * options.maxAttempts) {
+            ErrorHandler::reportError("Too many worker processes failed; giving up.");
+            return false;
+        }
+        ++restartCount;
+        return spawn_worker(slot);
+    }
+
+    void stop_workers() {
+        std::string message(1, static_cast<char>(kExit));
+        for (Worker& worker : workers) {
+            if (worker.fd >= 0) {
+                write_frame(worker.fd, message);
+                ::close(worker.fd);
+                worker.fd = -1;
+            }
+        }
+        for (Worker& worker : workers) {
+            if (worker.pid > 0) {
+                int status;
+                ::waitpid(worker.pid, &status, 0);
+                worker.pid = -1;
+            }
+        }
+        workers.clear();
+    }
+
+    // Worker process loop. Never returns; _exit skips the parent's static
+    // destructors (Logger, ThreadPool), whose threads were not forked.
+    [[noreturn]] void worker_main(int fd) {
+        std::string message;
+        while (read_frame(fd, message)) {
+            const char* pos = message.data();
+            const char* end = pos + message.size();
+            if (pos == end || static_cast<uint8_t>(*pos) == kExit) {
+                break;
+            }
+            uint8_t type = static_cast<uint8_t>(*pos++);
+            uint64_t id;
+            uint64_t attempt;
+            if (!RecordReader::read_varint(pos, end, id) || !RecordReader::read_varint(pos, end, attempt)) {
+                break;
+            }
+
+            bool ok = false;
+            if (type == kMapTask && id < job.splits->size()) {
+                if (options.crashTask >= 0 && id == static_cast<uint64_t>(options.crashTask) && attempt == 0) {
+                    ::_exit(1);
+                }
+                ok = run_map_task((*job.splits)[id], id, job.tempFolder, job.numPartitions, options.kernel);
+            } else if (type == kReduceTask && id < job.numPartitions) {
+                if (options.crashPartition >= 0 && id == static_cast<uint64_t>(options.crashPartition) && attempt == 0) {
+                    ::_exit(1);
+                }
+                ok = run_reduce_task(id, job.splits->size(), job.tempFolder, options.kernel);
+            }
+
+            // With resume, a success carries the size and hash of every file
+            // the task wrote, hashed here rather than in the driver
+            std::string checks;
+            for (const std::string& output : options.resume && ok
+                     ? task_outputs(type == kMapTask, id, job.tempFolder, job.numPartitions)
+                     : std::vector<std::string>()) {
+                JobManifest::FileCheck file;
+                ok = ok && JobManifest::check(output, file);
+                RecordWriter::append_varint(checks, file.size);
+                RecordWriter::append_varint(checks, file.hash);
+            }
+
+            std::string reply;
+            RecordWriter::append_varint(reply, id);
+            reply += static_cast<char>(ok ? 1 : 0);
+            reply += checks;
+            if (!write_frame(fd, reply)) {
+                break;
+            }
+        }
+        ::close(fd);
+        ::_exit(0);
+    }
+
+    // Frames are a 4-byte little-endian length followed by the payload.
+    static bool write_frame(int fd, const std::string& payload) {
+        std::string frame;
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        for (int i = 0; i < 4; ++i) {
+            frame += static_cast<char>((length >> (8 * i)) & 0xFF);
+        }
+        frame += payload;
+        size_t sent = 0;
+        while (sent < frame.size()) {
+            ssize_t n = ::send(fd, frame.data() + sent, frame.size() - sent, kSendFlags);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool read_frame(int fd, std::string& payload) {
+        unsigned char header[4];
+        if (!read_exact(fd, reinterpret_cast<char*>(header), 4)) {
+            return false;
+        }
+        uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+        payload.resize(length);
+        return length == 0 || read_exact(fd, &payload[0], length);
+    }
+
+    static bool read_exact(int fd, char* out, size_t size) {
+        size_t got = 0;
+        while (got < size) {
+            ssize_t n = ::read(fd, out + got, size - got);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            got += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // CPU lists of the NUMA nodes in /sys/devices/system/node, one entry
+    // per node; empty when the system exposes no node information.
+    static std::vector<std::vector<int>> numa_cpu_sets() {
+        std::vector<std::vector<int>> nodes;
+        for (int node = 0;; ++node) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!in || !std::getline(in, list)) {
+                break;
+            }
+            std::vector<int> cpus;
+            std::stringstream ranges(list);
+            std::string range;
+            while (std::getline(ranges, range, ',')) {
+                size_t dash = range.find('-');
+                int first = std::atoi(range.c_str());
+                int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) {
+                nodes.push_back(cpus);
+            }
+        }
+        return nodes;
+    }
+
+    static void pin_to(const std::vector<int>& cpus) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        ::sched_setaffinity(0, sizeof(set), &set);
+#else
+        (void)cpus;
+#endif
+    }
+
+    static std::string task_name(const Task& task) {
+        return std::string(task.type == kMapTask ? "map task " : "reduce task ") + std::to_string(task.id);
+    }
+
+    std::vector<Worker> workers;
+    std::vector<std::vector<int>> cpuSets;
+#endif
+
+    Options options;
+    Job job;
+    size_t restartCount = 0;
+    size_t resumedCount = 0;
+};
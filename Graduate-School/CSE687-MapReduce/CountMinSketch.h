@@ -0,0 +1,55 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "Hash.h"
+
+// Count-Min sketch: depth rows of width counters. Every estimate is an
+// upper bound on the true count, too high by at most 2N / width with
+// probability 1 - 2^-depth. Sketches of the same shape merge by adding
+// their counters, so map tasks can build one each and the reduce side sums
+// them. Rows are indexed by double hashing of one stable 64-bit hash.
+class CountMinSketch {
+public:
+    explicit CountMinSketch(size_t depth = 4, size_t width = 1 << 14)
+        : depth(depth > 0 ? depth : 1), width(width > 0 ? width : 1), cells(this->depth * this->width, 0) {}
+
+    void add(std::string_view key, uint64_t count = 1) {
+        uint64_t hash = Hash::mix(Hash::fnv1a(key));
+        for (size_t row = 0; row < depth; ++row) {
+            cells[row * width + column(hash, row)] += count;
+        }
+    }
+
+    uint64_t estimate(std::string_view key) const {
+        uint64_t hash = Hash::mix(Hash::fnv1a(key));
+        uint64_t best = UINT64_MAX;
+        for (size_t row = 0; row < depth; ++row) {
+            best = std::min(best, cells[row * width + column(hash, row)]);
+        }
+        return best;
+    }
+
+    // Returns false when the shapes differ.
+    bool merge(const CountMinSketch& other) {
+        if (other.depth != depth || other.width != width) {
+            return false;
+        }
+        for (size_t i = 0; i < cells.size(); ++i) {
+            cells[i] += other.cells[i];
+        }
+        return true;
+    }
+
+private:
+    size_t column(uint64_t hash, size_t row) const {
+        uint64_t h1 = hash & 0xFFFFFFFFu;
+        uint64_t h2 = (hash >> 32) | 1;
+        return static_cast<size_t>((h1 + row * h2) % width);
+    }
+
+    size_t depth;
+    size_t width;
+    std::vector<uint64_t> cells;
+};
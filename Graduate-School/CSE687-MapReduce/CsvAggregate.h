@@ -0,0 +1,488 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+#include "CsvReader.h"
+#include "ERROR_Handler.h"
+#include "FlatStringMap.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "ThreadPool.h"
+
+// Group-by aggregation over CSV input, e.g. the disease rate by age bucket,
+// cholesterol and smoking:
+//
+//     group by  Age:5, Cholesterol, Smoke      (Age in ranges of 5 years)
+//     measures  Disease                        (rows, sum, mean, min, max)
+//
+// Map: one task per input split reads column batches (CsvReader.h) and runs
+// the kernels a column at a time. Each group-by column turns into a code
+// per row (its dictionary code, or its bucket relative to the batch's
+// lowest), the codes are combined mixed-radix into one group index per
+// row, and every measure is then accumulated with one pass of
+// sums[group[i]] += value[i]. When the columns' ranges are too wide for a
+// 64-bit index (several wide integer columns), each row's codes are
+// interned instead. Only the groups present in a batch are turned into
+// keys and added to the task's table. Reduce: the task tables are merged,
+// which sums their totals.
+class CsvAggregate {
+public:
+    struct Key {
+        std::string column;
+        int64_t bucket = 0;     // > 0: integer column grouped into ranges this wide
+    };
+
+    struct Spec {
+        std::vector<Key> groupBy;
+        std::vector<std::string> measures;  // integer columns
+        char delimiter = ',';
+
+        // groupBy is "Age:5,Cholesterol,Smoke" (":<width>" buckets an
+        // integer column), measures is "Disease,Weight" (may be empty).
+        static bool parse(std::string_view groupBy, std::string_view measures, Spec& spec) {
+            spec.groupBy.clear();
+            spec.measures.clear();
+            for (std::string_view item : split_list(groupBy)) {
+                Key key;
+                size_t colon = item.rfind(':');
+                key.column = std::string(item.substr(0, colon));
+                if (colon != std::string_view::npos) {
+                    std::string width(item.substr(colon + 1));
+                    key.bucket = std::atoll(width.c_str());
+                    if (key.bucket <= 0) {
+                        ErrorHandler::reportError("Bad bucket width in group-by column '" + std::string(item) + "'.");
+                        return false;
+                    }
+                }
+                spec.groupBy.push_back(key);
+            }
+            for (std::string_view item : split_list(measures)) {
+                spec.measures.emplace_back(item);
+            }
+            if (spec.groupBy.empty()) {
+                ErrorHandler::reportError("No group-by columns given.");
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // Row count plus sum, min and max of every measure.
+    struct Totals {
+        uint64_t rows = 0;
+        std::vector<int64_t> sum;
+        std::vector<int64_t> min;
+        std::vector<int64_t> max;
+
+        void resize(size_t measures) {
+            sum.resize(measures, 0);
+            min.resize(measures, std::numeric_limits<int64_t>::max());
+            max.resize(measures, std::numeric_limits<int64_t>::min());
+        }
+
+        // FlatStringMap::merge combines tables with +=.
+        Totals& operator+=(const Totals& other) {
+            resize(other.sum.size());
+            rows += other.rows;
+            for (size_t m = 0; m < other.sum.size(); ++m) {
+                sum[m] += other.sum[m];
+                min[m] = std::min(min[m], other.min[m]);
+                max[m] = std::max(max[m], other.max[m]);
+            }
+            return *this;
+        }
+    };
+
+    struct Group {
+        std::vector<std::string> labels;    // per group-by column: value, or "lo-hi" for buckets
+        std::vector<int64_t> bounds;        // per group-by column: bucket's lower bound, else 0
+        Totals totals;
+    };
+
+    explicit CsvAggregate(Spec spec, ThreadPool& pool = ThreadPool::getInstance())
+        : spec(std::move(spec)), threadPool(pool) {
+        for (const Key& key : this->spec.groupBy) {
+            keyColumns.push_back(column_index(key.column, key.bucket > 0 ? CsvColumn::Type::Int : CsvColumn::Type::Category));
+        }
+        for (const std::string& measure : this->spec.measures) {
+            measureColumns.push_back(column_index(measure, CsvColumn::Type::Int));
+        }
+    }
+
+    // Aggregates every row of splits. Each file's first line is its header.
+    // Returns false if a file cannot be read, lacks a column, or has a
+    // malformed row.
+    bool run(const std::vector<InputSplit>& splits) {
+        result.clear();
+        if (conflict) {
+            ErrorHandler::reportError("A column is used both as a category and as an integer.");
+            return false;
+        }
+        std::vector<FlatStringMap<Totals>> tables(splits.size());
+        std::vector<char> succeeded(splits.size(), 0);
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([this, &splits, &tables, &succeeded, t]() {
+                Metrics::TaskScope task("csv_map", t);
+                if (map_split(splits[t], tables[t])) {
+                    succeeded[t] = 1;
+                }
+            });
+        }
+        threadPool.wait();
+
+        Metrics::TaskScope task("csv_reduce", 0);
+        FlatStringMap<Totals> merged;
+        bool ok = true;
+        for (size_t t = 0; t < splits.size(); ++t) {
+            ok = ok && succeeded[t];
+            merged.merge(std::move(tables[t]));
+        }
+        if (!ok) {
+            return false;
+        }
+        for (const auto& kv : merged) {
+            result.push_back(make_group(kv.first, kv.second));
+        }
+        std::sort(result.begin(), result.end(), [this](const Group& a, const Group& b) {
+            for (size_t k = 0; k < spec.groupBy.size(); ++k) {
+                if (spec.groupBy[k].bucket > 0 ? a.bounds[k] != b.bounds[k] : a.labels[k] != b.labels[k]) {
+                    return spec.groupBy[k].bucket > 0 ? a.bounds[k] < b.bounds[k] : a.labels[k] < b.labels[k];
+                }
+            }
+            return false;
+        });
+        Metrics::add(Metrics::RecordsOut, result.size());
+        return true;
+    }
+
+    // Groups of the last run, in key order (buckets numerically).
+    const std::vector<Group>& groups() const {
+        return result;
+    }
+
+    // One line per group: the group-by columns, rows, then sum, mean, min
+    // and max of every measure.
+    bool write_csv(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            ErrorHandler::reportError("Could not open file " + path + " for writing.");
+            return false;
+        }
+        char d = spec.delimiter;
+        for (const Key& key : spec.groupBy) {
+            out << quoted(key.column) << d;
+        }
+        out << "rows";
+        for (const std::string& measure : spec.measures) {
+            out << d << quoted(measure + "_sum") << d << quoted(measure + "_mean") << d << quoted(measure + "_min")
+                << d << quoted(measure + "_max");
+        }
+        out << "\n" << std::fixed << std::setprecision(4);
+        for (const Group& group : result) {
+            for (const std::string& label : group.labels) {
+                out << quoted(label) << d;
+            }
+            out << group.totals.rows;
+            for (size_t m = 0; m < spec.measures.size(); ++m) {
+                out << d << group.totals.sum[m] << d
+                    << static_cast<double>(group.totals.sum[m]) / static_cast<double>(group.totals.rows) << d
+                    << group.totals.min[m] << d << group.totals.max[m];
+            }
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+private:
+    // Separates the group-by values inside a table key.
+    static constexpr char kKeySeparator = '\x1f';
+
+    static std::vector<std::string_view> split_list(std::string_view list) {
+        std::vector<std::string_view> items;
+        while (!list.empty()) {
+            size_t comma = list.find(',');
+            std::string_view item = list.substr(0, comma);
+            while (!item.empty() && item.front() == ' ') {
+                item.remove_prefix(1);
+            }
+            while (!item.empty() && item.back() == ' ') {
+                item.remove_suffix(1);
+            }
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+        }
+        return items;
+    }
+
+    static int64_t floor_div(int64_t value, int64_t width) {
+        int64_t quotient = value / width;
+        return (value % width != 0 && value < 0) ? quotient - 1 : quotient;
+    }
+
+    // Reader column for a name, shared when a column is both a bucketed
+    // key and a measure.
+    size_t column_index(const std::string& name, CsvColumn::Type type) {
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (columns[c].name == name) {
+                conflict = conflict || columns[c].type != type;
+                return c;
+            }
+        }
+        columns.push_back(CsvColumn{name, type});
+        return columns.size() - 1;
+    }
+
+    std::string quoted(const std::string& field) const {
+        if (field.find_first_of(std::string(1, spec.delimiter) + "\"\n") == std::string::npos) {
+            return field;
+        }
+        std::string out = "\"";
+        for (char c : field) {
+            out += c;
+            if (c == '"') {
+                out += '"';
+            }
+        }
+        return out + "\"";
+    }
+
+    // Per-task scratch reused across batches.
+    struct Kernel {
+        std::vector<uint64_t> group;        // group index per row
+        std::vector<std::vector<uint64_t>> codes;   // per group-by column, code per row
+        std::vector<uint64_t> radix;        // codes per group-by column in this batch
+        std::vector<int64_t> lowest;        // lowest bucket per bucketed column
+        std::vector<uint64_t> slotKeys;     // group index of each slot
+        std::vector<uint64_t> slotCodes;    // per slot, its code in every group-by column
+        FlatStringMap<uint32_t> tuples;     // interned code tuples, when indexes overflow
+        std::string tuple;
+        std::vector<uint64_t> rows;
+        std::vector<std::vector<int64_t>> sum;
+        std::vector<std::vector<int64_t>> min;
+        std::vector<std::vector<int64_t>> max;
+        std::string key;
+    };
+
+    bool map_split(const InputSplit& split, FlatStringMap<Totals>& table) {
+        MappedFile file;
+        if (!file.open(split.path)) {
+            return false;
+        }
+        std::string_view text = MappedFile::line_range(file.view(), split.offset, split.length);
+        if (split.offset == 0) {
+            size_t newline = text.find('\n');
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        }
+        CsvReader reader(columns, spec.delimiter);
+        if (!reader.open(CsvReader::header_of(file.view()), text, split.path)) {
+            return false;
+        }
+        ColumnBatch batch;
+        Kernel kernel;
+        uint64_t rows = 0;
+        while (reader.next(batch)) {
+            rows += batch.rows;
+            if (!aggregate_batch(batch, reader, kernel, table)) {
+                return false;
+            }
+        }
+        Metrics::add(Metrics::BytesRead, text.size());
+        Metrics::add(Metrics::RecordsIn, rows);
+        return !reader.failed();
+    }
+
+    bool aggregate_batch(const ColumnBatch& batch, const CsvReader& reader, Kernel& kernel, FlatStringMap<Totals>& table) {
+        size_t rows = batch.rows;
+        size_t keys = spec.groupBy.size();
+        kernel.radix.assign(keys, 1);
+        kernel.lowest.assign(keys, 0);
+        kernel.codes.resize(keys);
+
+        // Code per row, one column at a time: dictionary codes, or buckets
+        // relative to the batch's lowest
+        bool overflow = false;
+        uint64_t combinations = 1;
+        for (size_t k = 0; k < keys; ++k) {
+            size_t c = keyColumns[k];
+            std::vector<uint64_t>& codes = kernel.codes[k];
+            codes.resize(rows);
+            uint64_t radix;
+            if (spec.groupBy[k].bucket > 0) {
+                const std::vector<int64_t>& values = batch.ints[c];
+                int64_t width = spec.groupBy[k].bucket;
+                int64_t low = std::numeric_limits<int64_t>::max();
+                int64_t high = std::numeric_limits<int64_t>::min();
+                for (size_t i = 0; i < rows; ++i) {
+                    int64_t bucket = floor_div(values[i], width);
+                    codes[i] = static_cast<uint64_t>(bucket);
+                    low = std::min(low, bucket);
+                    high = std::max(high, bucket);
+                }
+                for (size_t i = 0; i < rows; ++i) {
+                    codes[i] -= static_cast<uint64_t>(low);
+                }
+                radix = static_cast<uint64_t>(high) - static_cast<uint64_t>(low) + 1;
+                kernel.lowest[k] = low;
+            } else {
+                const std::vector<uint32_t>& dictionaryCodes = batch.codes[c];
+                codes.assign(dictionaryCodes.begin(), dictionaryCodes.end());
+                radix = reader.dictionary(c).size();
+            }
+            kernel.radix[k] = radix;
+            // radix 0: a bucketed column spanning all of int64_t
+            if (radix == 0 || combinations > std::numeric_limits<uint64_t>::max() / radix) {
+                overflow = true;
+            } else {
+                combinations *= radix;
+            }
+        }
+
+        // Slots: the groups present in the batch, each with its codes
+        kernel.slotCodes.clear();
+        kernel.group.assign(rows, 0);
+        size_t slots;
+        if (overflow) {
+            // Too many combinations for one index: intern each row's codes
+            kernel.tuples.clear();
+            for (size_t i = 0; i < rows; ++i) {
+                kernel.tuple.clear();
+                for (size_t k = 0; k < keys; ++k) {
+                    kernel.tuple.append(reinterpret_cast<const char*>(&kernel.codes[k][i]), sizeof(uint64_t));
+                }
+                uint32_t& slot = kernel.tuples[kernel.tuple];
+                if (slot == 0) {
+                    slot = static_cast<uint32_t>(kernel.slotCodes.size() / keys) + 1;
+                    for (size_t k = 0; k < keys; ++k) {
+                        kernel.slotCodes.push_back(kernel.codes[k][i]);
+                    }
+                }
+                kernel.group[i] = slot - 1;
+            }
+            slots = kernel.slotCodes.size() / keys;
+        } else {
+            // Mixed-radix group index per row. Groups index the accumulators
+            // directly when there are few of them, otherwise they are
+            // renumbered by the distinct indexes present
+            for (size_t k = 0; k < keys; ++k) {
+                const std::vector<uint64_t>& codes = kernel.codes[k];
+                uint64_t radix = kernel.radix[k];
+                for (size_t i = 0; i < rows; ++i) {
+                    kernel.group[i] = kernel.group[i] * radix + codes[i];
+                }
+            }
+            kernel.slotKeys.clear();
+            if (combinations <= rows) {
+                for (uint64_t g = 0; g < combinations; ++g) {
+                    kernel.slotKeys.push_back(g);
+                }
+            } else {
+                kernel.slotKeys.assign(kernel.group.begin(), kernel.group.end());
+                std::sort(kernel.slotKeys.begin(), kernel.slotKeys.end());
+                kernel.slotKeys.erase(std::unique(kernel.slotKeys.begin(), kernel.slotKeys.end()), kernel.slotKeys.end());
+                for (size_t i = 0; i < rows; ++i) {
+                    kernel.group[i] = static_cast<uint64_t>(
+                        std::lower_bound(kernel.slotKeys.begin(), kernel.slotKeys.end(), kernel.group[i]) - kernel.slotKeys.begin());
+                }
+            }
+            slots = kernel.slotKeys.size();
+            kernel.slotCodes.resize(slots * keys);
+            for (size_t s = 0; s < slots; ++s) {
+                uint64_t index = kernel.slotKeys[s];
+                for (size_t k = keys; k-- > 0;) {
+                    kernel.slotCodes[s * keys + k] = index % kernel.radix[k];
+                    index /= kernel.radix[k];
+                }
+            }
+        }
+
+        // Accumulate, one measure column at a time
+        size_t measures = spec.measures.size();
+        kernel.rows.assign(slots, 0);
+        kernel.sum.resize(measures);
+        kernel.min.resize(measures);
+        kernel.max.resize(measures);
+        for (size_t i = 0; i < rows; ++i) {
+            ++kernel.rows[kernel.group[i]];
+        }
+        for (size_t m = 0; m < measures; ++m) {
+            const std::vector<int64_t>& values = batch.ints[measureColumns[m]];
+            std::vector<int64_t>& sum = kernel.sum[m];
+            std::vector<int64_t>& min = kernel.min[m];
+            std::vector<int64_t>& max = kernel.max[m];
+            sum.assign(slots, 0);
+            min.assign(slots, std::numeric_limits<int64_t>::max());
+            max.assign(slots, std::numeric_limits<int64_t>::min());
+            for (size_t i = 0; i < rows; ++i) {
+                uint64_t g = kernel.group[i];
+                sum[g] += values[i];
+                min[g] = std::min(min[g], values[i]);
+                max[g] = std::max(max[g], values[i]);
+            }
+        }
+
+        // Only the groups present become keys
+        for (size_t s = 0; s < slots; ++s) {
+            if (kernel.rows[s] == 0) {
+                continue;
+            }
+            const uint64_t* codes = &kernel.slotCodes[s * keys];
+            kernel.key.clear();
+            for (size_t k = 0; k < keys; ++k) {
+                if (k > 0) {
+                    kernel.key += kKeySeparator;
+                }
+                if (spec.groupBy[k].bucket > 0) {
+                    kernel.key += std::to_string((kernel.lowest[k] + static_cast<int64_t>(codes[k])) * spec.groupBy[k].bucket);
+                } else {
+                    kernel.key += reader.dictionary(keyColumns[k])[codes[k]];
+                }
+            }
+            Totals& totals = table[kernel.key];
+            totals.resize(measures);
+            totals.rows += kernel.rows[s];
+            for (size_t m = 0; m < measures; ++m) {
+                totals.sum[m] += kernel.sum[m][s];
+                totals.min[m] = std::min(totals.min[m], kernel.min[m][s]);
+                totals.max[m] = std::max(totals.max[m], kernel.max[m][s]);
+            }
+        }
+        return true;
+    }
+
+    Group make_group(std::string_view key, const Totals& totals) const {
+        Group group;
+        group.totals = totals;
+        for (size_t k = 0; k < spec.groupBy.size(); ++k) {
+            size_t separator = key.find(kKeySeparator);
+            std::string value(key.substr(0, separator));
+            key.remove_prefix(separator == std::string_view::npos ? key.size() : separator + 1);
+            if (spec.groupBy[k].bucket > 0) {
+                int64_t low = std::atoll(value.c_str());
+                group.bounds.push_back(low);
+                group.labels.push_back(spec.groupBy[k].bucket == 1 ? value
+                                       : value + "-" + std::to_string(low + spec.groupBy[k].bucket - 1));
+            } else {
+                group.bounds.push_back(0);
+                group.labels.push_back(value);
+            }
+        }
+        return group;
+    }
+
+    Spec spec;
+    ThreadPool& threadPool;
+    std::vector<CsvColumn> columns;     // what the readers parse
+    std::vector<size_t> keyColumns;     // reader column of each group-by column
+    std::vector<size_t> measureColumns; // reader column of each measure
+    bool conflict = false;
+    std::vector<Group> result;
+};
@@ -0,0 +1,237 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include "ERROR_Handler.h"
+#include "FlatStringMap.h"
+
+// Delimited text input for tabular jobs. Only the columns a job asks for
+// are parsed, and rows come out in column-major batches so group-by and
+// aggregate kernels run tight loops over one column at a time instead of
+// handling a row of strings per record:
+//
+//     Int       int64_t per row
+//     Category  uint32_t code per row into a dictionary of distinct values
+//
+// Columns are found by name in the file's header line, so files with the
+// same columns in another order (or with extra ones) read the same. Fields
+// may be quoted ("a, b" or "say ""hi"""), but a quoted field cannot span
+// lines: input is cut into line-aligned splits like any other text.
+struct CsvColumn {
+    enum class Type { Int, Category };
+
+    std::string name;
+    Type type = Type::Category;
+};
+
+// Rows [0, rows) of a batch, by requested column: ints[c] for Int columns,
+// codes[c] for Category columns (the other vector is empty).
+struct ColumnBatch {
+    size_t rows = 0;
+    std::vector<std::vector<int64_t>> ints;
+    std::vector<std::vector<uint32_t>> codes;
+};
+
+class CsvReader {
+public:
+    static constexpr size_t kBatchRows = 4096;
+
+    explicit CsvReader(std::vector<CsvColumn> columns, char delimiter = ',')
+        : columns(std::move(columns)), delimiter(delimiter),
+          lookup(this->columns.size()), dictionaries(this->columns.size()) {}
+
+    // Starts reading the rows in text. header is the file's first line and
+    // source names the input in error messages. Returns false if a column is
+    // not in the header. Dictionaries carry over from earlier inputs, so a
+    // code means the same value for the reader's whole life.
+    bool open(std::string_view header, std::string_view text, const std::string& source) {
+        this->source = source;
+        rest = text;
+        malformed = false;
+        fieldColumn.clear();
+        std::vector<std::string> names;
+        std::string_view field;
+        for (std::string_view line = strip_cr(header); ;) {
+            size_t consumed = next_field(line, field);
+            names.emplace_back(field);
+            if (consumed >= line.size()) {
+                break;
+            }
+            line.remove_prefix(consumed + 1);
+        }
+        for (size_t c = 0; c < columns.size(); ++c) {
+            size_t found = 0;
+            while (found < names.size() && names[found] != columns[c].name) {
+                ++found;
+            }
+            if (found == names.size()) {
+                ErrorHandler::reportError("Column '" + columns[c].name + "' is not in the header of " + source + ".");
+                return false;
+            }
+            if (fieldColumn.size() <= found) {
+                fieldColumn.resize(found + 1, kSkip);
+            }
+            if (fieldColumn[found] != kSkip) {
+                ErrorHandler::reportError("Column '" + columns[c].name + "' is requested twice.");
+                return false;
+            }
+            fieldColumn[found] = static_cast<uint32_t>(c);
+        }
+        return true;
+    }
+
+    // Parses up to kBatchRows rows into batch. Blank lines are skipped.
+    // Returns false at the end of the text or on a malformed row (see
+    // failed()); rows parsed before a malformed one are not returned.
+    bool next(ColumnBatch& batch) {
+        batch.rows = 0;
+        batch.ints.resize(columns.size());
+        batch.codes.resize(columns.size());
+        for (size_t c = 0; c < columns.size(); ++c) {
+            batch.ints[c].clear();
+            batch.codes[c].clear();
+        }
+        while (batch.rows < kBatchRows && !rest.empty()) {
+            size_t newline = rest.find('\n');
+            std::string_view line = strip_cr(rest.substr(0, newline));
+            rest.remove_prefix(newline == std::string_view::npos ? rest.size() : newline + 1);
+            if (line.empty()) {
+                continue;
+            }
+            if (!parse_row(line, batch)) {
+                malformed = true;
+                return false;
+            }
+            ++batch.rows;
+        }
+        return batch.rows > 0;
+    }
+
+    bool failed() const {
+        return malformed;
+    }
+
+    // Distinct values of a Category column, indexed by code.
+    const std::vector<std::string>& dictionary(size_t column) const {
+        return dictionaries[column];
+    }
+
+    const std::vector<CsvColumn>& schema() const {
+        return columns;
+    }
+
+    // First line of a file, for open().
+    static std::string_view header_of(std::string_view file) {
+        size_t newline = file.find('\n');
+        return file.substr(0, newline == std::string_view::npos ? file.size() : newline);
+    }
+
+private:
+    static constexpr uint32_t kSkip = ~uint32_t(0);
+
+    static std::string_view strip_cr(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    // Points field at the field that starts line: a view into line, or into
+    // scratch when it had to be unquoted. Returns how many bytes it spanned,
+    // i.e. the position of the delimiter after it (or line.size()).
+    size_t next_field(std::string_view line, std::string_view& field) {
+        if (line.empty() || line.front() != '"') {
+            const void* hit = line.empty() ? nullptr : std::memchr(line.data(), delimiter, line.size());
+            size_t end = hit != nullptr ? static_cast<size_t>(static_cast<const char*>(hit) - line.data()) : line.size();
+            field = line.substr(0, end);
+            return end;
+        }
+        scratch.clear();
+        size_t pos = 1;
+        while (pos < line.size()) {
+            if (line[pos] != '"') {
+                scratch += line[pos++];
+            } else if (pos + 1 < line.size() && line[pos + 1] == '"') {
+                scratch += '"';
+                pos += 2;
+            } else {
+                ++pos;
+                break;
+            }
+        }
+        while (pos < line.size() && line[pos] != delimiter) {
+            ++pos;
+        }
+        field = scratch;
+        return pos;
+    }
+
+    bool parse_row(std::string_view line, ColumnBatch& batch) {
+        size_t wanted = columns.size();
+        std::string_view field;
+        for (size_t f = 0; f < fieldColumn.size(); ++f) {
+            size_t consumed = next_field(line, field);
+            uint32_t c = fieldColumn[f];
+            if (c != kSkip) {
+                if (!store(c, field, batch)) {
+                    return false;
+                }
+                if (--wanted == 0) {
+                    break;
+                }
+            }
+            if (consumed >= line.size()) {
+                ErrorHandler::reportError("Row of " + source + " has too few fields: " + std::string(line));
+                return false;
+            }
+            line.remove_prefix(consumed + 1);
+        }
+        return true;
+    }
+
+    bool store(uint32_t c, std::string_view value, ColumnBatch& batch) {
+        if (columns[c].type == CsvColumn::Type::Int) {
+            while (!value.empty() && value.front() == ' ') {
+                value.remove_prefix(1);
+            }
+            while (!value.empty() && value.back() == ' ') {
+                value.remove_suffix(1);
+            }
+            if (!value.empty() && value.front() == '+') {
+                value.remove_prefix(1);
+            }
+            int64_t number = 0;
+            auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+            if (value.empty() || result.ec != std::errc() || result.ptr != value.data() + value.size()) {
+                ErrorHandler::reportError("Column '" + columns[c].name + "' of " + source + " holds '" +
+                                          std::string(value) + "', not an integer.");
+                return false;
+            }
+            batch.ints[c].push_back(number);
+            return true;
+        }
+        const uint32_t* code = lookup[c].find(value);
+        if (code == nullptr) {
+            uint32_t next = static_cast<uint32_t>(dictionaries[c].size());
+            lookup[c][value] = next;
+            dictionaries[c].emplace_back(value);
+            batch.codes[c].push_back(next);
+        } else {
+            batch.codes[c].push_back(*code);
+        }
+        return true;
+    }
+
+    std::vector<CsvColumn> columns;
+    char delimiter;
+    std::vector<FlatStringMap<uint32_t>> lookup;
+    std::vector<std::vector<std::string>> dictionaries;
+    std::vector<uint32_t> fieldColumn;   // requested column of each header field, or kSkip
+    std::string_view rest;
+    std::string source;
+    std::string scratch;                 // unquoted copy of the current field
+    bool malformed = false;
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include "ERROR_Handler.h"
+#include "FlatStringMap.h"
+#include "RecordIO.h"
+
+// Out-of-core reduce for inputs that do not fit in memory.
+//
+// build_runs() streams spill records into a FlatStringMap until it reaches
+// the memory budget, then writes the aggregated table sorted by key as a run
+// file and starts over. merge_runs() does a k-way heap merge over the runs,
+// summing equal keys, and hands each distinct key to the caller exactly once
+// in ascending order, so the result can be streamed to output.txt without
+// ever materializing it. Runs use the binary record format of RecordIO.h.
+class ExternalSort {
+public:
+    // At most this many runs are open at once; more runs are merged in
+    // several passes.
+    static constexpr size_t kMaxFanIn = 128;
+
+    static bool build_runs(const std::vector<std::string>& inputPaths, const std::string& runPrefix,
+                           size_t memoryBudget, std::vector<std::string>& runPaths) {
+        FlatStringMap<uint64_t> buffer;
+        for (const std::string& inputPath : inputPaths) {
+            RecordReader reader;
+            if (!reader.open(inputPath)) {
+                return false;
+            }
+            std::string_view key;
+            uint64_t count;
+            while (reader.next(key, count)) {
+                if (key.empty()) {
+                    continue;
+                }
+                buffer[key] += count;
+                if (buffer.memory_bytes() >= memoryBudget) {
+                    if (!write_run(buffer, runPrefix, runPaths)) {
+                        return false;
+                    }
+                    buffer = FlatStringMap<uint64_t>();
+                }
+            }
+            if (reader.truncated()) {
+                ErrorHandler::reportError("File " + inputPath + " ends in the middle of a record.");
+                return false;
+            }
+        }
+        return buffer.empty() || write_run(buffer, runPrefix, runPaths);
+    }
+
+    // Calls emit(std::string_view key, uint64_t count) once per distinct key
+    // across all runs, in ascending key order.
+    template <typename Emit>
+    static bool merge_runs(const std::vector<std::string>& runPaths, Emit&& emit) {
+        std::vector<std::unique_ptr<RecordReader>> readers;
+        for (const std::string& runPath : runPaths) {
+            readers.push_back(std::make_unique<RecordReader>());
+            if (!readers.back()->open(runPath)) {
+                return false;
+            }
+        }
+
+        struct Head {
+            std::string_view key;
+            uint64_t count;
+            size_t run;
+        };
+        auto later = [](const Head& a, const Head& b) { return a.key > b.key; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+
+        // A reader's key view stays valid until that reader is advanced, and
+        // a reader is only advanced after its head has been popped.
+        auto advance = [&readers, &heap](size_t run) {
+            Head head{{}, 0, run};
+            if (readers[run]->next(head.key, head.count)) {
+                heap.push(head);
+            }
+        };
+        for (size_t run = 0; run < readers.size(); ++run) {
+            advance(run);
+        }
+
+        std::string currentKey;
+        uint64_t currentCount = 0;
+        bool haveCurrent = false;
+        while (!heap.empty()) {
+            Head head = heap.top();
+            heap.pop();
+            if (haveCurrent && head.key == currentKey) {
+                currentCount += head.count;
+            } else {
+                if (haveCurrent) {
+                    emit(std::string_view(currentKey), currentCount);
+                }
+                currentKey.assign(head.key.data(), head.key.size());
+                currentCount = head.count;
+                haveCurrent = true;
+            }
+            advance(head.run);
+        }
+        if (haveCurrent) {
+            emit(std::string_view(currentKey), currentCount);
+        }
+
+        for (size_t run = 0; run < readers.size(); ++run) {
+            if (readers[run]->truncated()) {
+                ErrorHandler::reportError("Run file " + runPaths[run] + " ends in the middle of a record.");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Merges groups of kMaxFanIn runs into larger runs until at most
+    // kMaxFanIn remain, deleting the inputs of each pass.
+    static bool reduce_fan_in(std::vector<std::string>& runPaths, const std::string& runPrefix) {
+        size_t pass = 0;
+        while (runPaths.size() > kMaxFanIn) {
+            std::vector<std::string> merged;
+            for (size_t begin = 0; begin < runPaths.size(); begin += kMaxFanIn) {
+                size_t end = std::min(begin + kMaxFanIn, runPaths.size());
+                std::vector<std::string> group(runPaths.begin() + begin, runPaths.begin() + end);
+                std::string outputPath = runPrefix + "_pass" + std::to_string(pass) + "_" + std::to_string(merged.size()) + ".bin";
+                RecordWriter writer;
+                if (!writer.open(outputPath)) {
+                    return false;
+                }
+                if (!merge_runs(group, [&writer](std::string_view key, uint64_t count) { writer.write(key, count); })) {
+                    return false;
+                }
+                if (!writer.close()) {
+                    return false;
+                }
+                remove_runs(group);
+                merged.push_back(outputPath);
+            }
+            runPaths.swap(merged);
+            ++pass;
+        }
+        return true;
+    }
+
+    static void remove_runs(const std::vector<std::string>& runPaths) {
+        for (const std::string& runPath : runPaths) {
+            std::remove(runPath.c_str());
+        }
+    }
+
+private:
+    static bool write_run(const FlatStringMap<uint64_t>& buffer, const std::string& runPrefix,
+                          std::vector<std::string>& runPaths) {
+        std::string runPath = runPrefix + "_" + std::to_string(runPaths.size()) + ".bin";
+        RecordWriter writer;
+        if (!writer.open(runPath)) {
+            return false;
+        }
+        for (const auto* entry : buffer.sorted()) {
+            writer.write(entry->first, entry->second);
+        }
+        if (!writer.close()) {
+            return false;
+        }
+        runPaths.push_back(runPath);
+        return true;
+    }
+};
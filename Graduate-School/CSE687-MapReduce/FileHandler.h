@@ -1,11 +1,16 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
+#include <sstream>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
 #include "ERROR_Handler.h"
 #include "Logger.h"
+#include "FlatStringMap.h"
+#include "RecordIO.h"
 
 /*
 // CALLS FOR IF DYNAMIC VALIDATE DIRECTORY IS USED
@@ -196,7 +201,7 @@ public:
         return true;
     }
 
-    static bool write_output(const std::string &filename, const std::map<std::string, int> &data) {
+    static bool write_output(const std::string &filename, const std::map<std::string, uint64_t> &data) {
         std::ofstream file(filename);
         if (!file) {
             ErrorHandler::reportError("Could not open file " + filename + " for writing.");
@@ -210,6 +215,46 @@ public:
     }
 
     
+    // Sorts by key here, once, rather than keeping a std::map sorted on
+    // every insert during reduce.
+    static bool write_output(const std::string &filename, const FlatStringMap<uint64_t> &data) {
+        std::ofstream file(filename);
+        if (!file) {
+            ErrorHandler::reportError("Could not open file " + filename + " for writing.");
+            return false;
+        }
+        for (const auto *kv : data.sorted()) {
+            file << kv->first << ": " << kv->second << "\n";
+        }
+        file.close();
+        return true;
+    }
+
+    // Streaming form for results that are never held in memory.
+    // produce(emit) must call emit(key, count) once per key, in the order
+    // the output should have (ascending key for full results, by count for
+    // top-K); both output.txt and output_summed.txt are written as it goes.
+    template <typename Produce>
+    static bool write_outputs_streamed(const std::string &filename, const std::string &summed_filename, Produce &&produce) {
+        std::ofstream file(filename);
+        if (!file) {
+            ErrorHandler::reportError("Could not open file " + filename + " for writing.");
+            return false;
+        }
+        std::ofstream summed(summed_filename);
+        if (!summed) {
+            ErrorHandler::reportError("Could not open file " + summed_filename + " for writing.");
+            return false;
+        }
+        bool produced = produce([&file, &summed](std::string_view key, uint64_t count) {
+            file << key << ": " << count << "\n";
+            summed << "<\"" << key << "\", " << count << ">\n";
+        });
+        file.close();
+        summed.close();
+        return produced && file && summed;
+    }
+
     static bool create_temp_log_file(const std::string &folder_path, const std::string &logFilePath)
     {
 
@@ -251,15 +296,15 @@ public:
         }
     }
 
-    static bool write_summed_output(const std::string &filename, const std::map<std::string, std::vector<int>> &data) {
+    static bool write_summed_output(const std::string &filename, const std::map<std::string, std::vector<uint64_t>> &data) {
         std::ofstream outfile(filename);
         if (!outfile) {
             ErrorHandler::reportError("Could not open file " + filename + " for writing.");
             return false;
         }
         for (const auto &kv : data) {
-            int sum = 0;
-            for (int count : kv.second) {
+            uint64_t sum = 0;
+            for (uint64_t count : kv.second) {
                 sum += count;
             }
             outfile << "<\"" << kv.first << "\", " << sum << ">\n";
@@ -268,30 +313,49 @@ public:
         return true;
     }
 
-    static bool read_mapped_data(const std::string &filename, std::vector<std::pair<std::string, int>> &mapped_data) {
-        std::ifstream infile(filename);
-        if (!infile) {
-            ErrorHandler::reportError("Could not open file " + filename + " for reading.");
+    static bool write_summed_output(const std::string &filename, const std::map<std::string, uint64_t> &data) {
+        std::ofstream outfile(filename);
+        if (!outfile) {
+            ErrorHandler::reportError("Could not open file " + filename + " for writing.");
             return false;
         }
-        std::string line;
-        while (std::getline(infile, line)) {
-            std::string word;
-            int count;
-            size_t start = line.find('<');
-            size_t comma = line.find(',', start);
-            size_t end = line.find('>', comma);
-            if (start != std::string::npos && comma != std::string::npos && end != std::string::npos) {
-                word = line.substr(start + 1, comma - start - 1);
-                std::string count_str = line.substr(comma + 1, end - comma - 1);
-                std::stringstream ss(count_str);
-                ss >> count;
-                if (!word.empty()) {
-                    mapped_data.emplace_back(word, count);
-                }
+        for (const auto &kv : data) {
+            outfile << "<\"" << kv.first << "\", " << kv.second << ">\n";
+        }
+        outfile.close();
+        return true;
+    }
+
+    static bool write_summed_output(const std::string &filename, const FlatStringMap<uint64_t> &data) {
+        std::ofstream outfile(filename);
+        if (!outfile) {
+            ErrorHandler::reportError("Could not open file " + filename + " for writing.");
+            return false;
+        }
+        for (const auto *kv : data.sorted()) {
+            outfile << "<\"" << kv->first << "\", " << kv->second << ">\n";
+        }
+        outfile.close();
+        return true;
+    }
+
+    // Reads a spill file written in the binary record format (RecordIO.h).
+    static bool read_mapped_data(const std::string &filename, std::vector<std::pair<std::string, uint64_t>> &mapped_data) {
+        RecordReader reader;
+        if (!reader.open(filename)) {
+            return false;
+        }
+        std::string_view word;
+        uint64_t count;
+        while (reader.next(word, count)) {
+            if (!word.empty()) {
+                mapped_data.emplace_back(std::string(word), count);
             }
         }
-        infile.close();
+        if (reader.truncated()) {
+            ErrorHandler::reportError("File " + filename + " ends in the middle of a record.");
+            return false;
+        }
         return true;
     }
 
@@ -303,17 +367,27 @@ public:
         }
         std::string kv_line;
         while (std::getline(infile, kv_line)) {
-            size_t quote_pos = kv_line.find("\", \"");
-            if (quote_pos != std::string::npos) {
-                std::string value = kv_line.substr(quote_pos + 4);
-                if (!value.empty() && value.back() == '>')
-                    value.pop_back();
-                if (!value.empty() && value.back() == '"')
-                    value.pop_back();
-                lines.push_back(value);
+            std::string_view value;
+            if (extract_value(kv_line, value)) {
+                lines.emplace_back(value);
             }
         }
         infile.close();
         return true;
     }
+
+    // Pulls the value out of a tempInput.txt record of the form
+    // <"filename", "line">. The returned view points into kv_line.
+    static bool extract_value(std::string_view kv_line, std::string_view &value) {
+        size_t quote_pos = kv_line.find("\", \"");
+        if (quote_pos == std::string_view::npos) {
+            return false;
+        }
+        value = kv_line.substr(quote_pos + 4);
+        if (!value.empty() && value.back() == '>')
+            value.remove_suffix(1);
+        if (!value.empty() && value.back() == '"')
+            value.remove_suffix(1);
+        return true;
+    }
 };
\ No newline at end of file
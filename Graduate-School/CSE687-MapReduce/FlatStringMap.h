@@ -0,0 +1,154 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include "Hash.h"
+#include "StringPool.h"
+
+// Open-addressing hash map from string keys to Value, used for word counts
+// in place of std::map<std::string, int>.
+//
+// Entries are stored densely as (key, value) pairs in insertion order; the
+// probe table holds only 32-bit entry indexes, and each key's hash is kept
+// alongside so probing and rehashing never re-hash a string. Key bytes are
+// interned in a StringPool owned by the map. Lookups touch one or two cache
+// lines instead of walking a red-black tree, and a new key costs a bump
+// allocation instead of a node plus a std::string.
+//
+// Iteration order is insertion order. Use sorted() when key order matters;
+// FileHandler::write_output does that once, at output time.
+template <typename Value>
+class FlatStringMap {
+public:
+    using Entry = std::pair<std::string_view, Value>;
+
+    explicit FlatStringMap(size_t expectedEntries = 0) {
+        size_t capacity = 16;
+        while (capacity < expectedEntries * 2) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, 0);
+        entries.reserve(expectedEntries);
+        hashes.reserve(expectedEntries);
+    }
+
+    FlatStringMap(FlatStringMap&&) = default;
+    FlatStringMap& operator=(FlatStringMap&&) = default;
+    FlatStringMap(const FlatStringMap&) = delete;
+    FlatStringMap& operator=(const FlatStringMap&) = delete;
+
+    Value& operator[](std::string_view key) {
+        uint64_t hash = hash_of(key);
+        size_t slot = probe(key, hash);
+        if (slots[slot] != 0) {
+            return entries[slots[slot] - 1].second;
+        }
+        return insert_at(slot, pool.intern(key), hash, Value()).second;
+    }
+
+    const Value* find(std::string_view key) const {
+        size_t slot = probe(key, hash_of(key));
+        return slots[slot] != 0 ? &entries[slots[slot] - 1].second : nullptr;
+    }
+
+    // Adds every entry of other into this map. Keys are not copied: other's
+    // key storage is taken over, so other is left empty.
+    void merge(FlatStringMap&& other) {
+        if (&other == this) {
+            return;
+        }
+        pool.adopt(std::move(other.pool));
+        for (size_t i = 0; i < other.entries.size(); ++i) {
+            Entry& entry = other.entries[i];
+            uint64_t hash = other.hashes[i];
+            size_t slot = probe(entry.first, hash);
+            if (slots[slot] != 0) {
+                entries[slots[slot] - 1].second += entry.second;
+            } else {
+                insert_at(slot, entry.first, hash, std::move(entry.second));
+            }
+        }
+        other.clear();
+    }
+
+    void clear() {
+        std::fill(slots.begin(), slots.end(), 0);
+        entries.clear();
+        hashes.clear();
+        pool.clear();
+    }
+
+    // Entries ordered by key, for output.
+    std::vector<const Entry*> sorted() const {
+        std::vector<const Entry*> ordered;
+        ordered.reserve(entries.size());
+        for (const Entry& entry : entries) {
+            ordered.push_back(&entry);
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const Entry* a, const Entry* b) {
+            return a->first < b->first;
+        });
+        return ordered;
+    }
+
+    // Approximate heap footprint: key bytes plus the three arrays.
+    size_t memory_bytes() const {
+        return pool.bytes_used() + entries.capacity() * sizeof(Entry) +
+               hashes.capacity() * sizeof(uint64_t) + slots.capacity() * sizeof(uint32_t);
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    typename std::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+    typename std::vector<Entry>::const_iterator end() const { return entries.end(); }
+
+private:
+    static uint64_t hash_of(std::string_view key) {
+        return Hash::mix(Hash::fnv1a(key));
+    }
+
+    // Slot holding key, or the empty slot where it would be inserted.
+    size_t probe(std::string_view key, uint64_t hash) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (slots[slot] != 0) {
+            size_t index = slots[slot] - 1;
+            if (hashes[index] == hash && entries[index].first == key) {
+                return slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    Entry& insert_at(size_t slot, std::string_view storedKey, uint64_t hash, Value value) {
+        entries.emplace_back(storedKey, std::move(value));
+        hashes.push_back(hash);
+        slots[slot] = static_cast<uint32_t>(entries.size());
+        if (entries.size() * 2 > slots.size()) {
+            grow();
+        }
+        return entries.back();
+    }
+
+    void grow() {
+        std::vector<uint32_t> bigger(slots.size() * 2, 0);
+        size_t mask = bigger.size() - 1;
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            size_t slot = static_cast<size_t>(hashes[i]) & mask;
+            while (bigger[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            bigger[slot] = static_cast<uint32_t>(i + 1);
+        }
+        slots.swap(bigger);
+    }
+
+    std::vector<uint32_t> slots;
+    std::vector<Entry> entries;
+    std::vector<uint64_t> hashes;
+    StringPool pool;
+};
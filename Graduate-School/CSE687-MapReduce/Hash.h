@@ -0,0 +1,47 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+// Stable string hashing shared by partitioning and the in-memory tables.
+// std::hash is allowed to differ between runs and processes; these are not.
+class Hash {
+public:
+    // 64-bit FNV-1a
+    static uint64_t fnv1a(std::string_view key) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Finalizer from MurmurHash3. Tables index with mix(h) so their slot
+    // bits are independent of the partition (h % R) a key was routed by.
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Hash of a whole file's bytes, for telling changed contents apart. Not
+    // cryptographic; eight bytes per step so hashing keeps up with the disk.
+    static uint64_t content(std::string_view bytes) {
+        uint64_t hash = 14695981039346656037ull ^ bytes.size();
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i, sizeof(word));
+            hash = (hash ^ mix(word)) * 1099511628211ull;
+        }
+        uint64_t tail = 0;
+        if (i < bytes.size()) {
+            std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+        }
+        return mix(hash ^ mix(tail ^ 0x9e3779b97f4a7c15ull));
+    }
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include "ERROR_Handler.h"
+#include "TaskChunking.h"
+
+// One unit of map input: a byte range of one input file. Small files are a
+// single split; large files are cut into fixed-size ranges so several map
+// tasks can read and tokenize the same file at once.
+//
+// Range boundaries are raw byte offsets; MappedFile::line_range snaps them
+// to lines. A split owns every line that starts inside its range, so each
+// line is counted exactly once no matter where the cuts fall.
+struct InputSplit {
+    std::string path;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+
+    static constexpr uint64_t kMinSplitBytes = 1ull << 20;
+    static constexpr uint64_t kMaxSplitBytes = 64ull << 20;
+
+    // Aims for TaskChunking::kTasksPerWorker splits per worker so a slow
+    // disk region or a long file does not leave the rest of the pool idle.
+    static uint64_t default_split_bytes(uint64_t totalBytes, size_t workers) {
+        uint64_t target = TaskChunking::target_bytes(totalBytes, workers, kMinSplitBytes);
+        return target > kMaxSplitBytes ? kMaxSplitBytes : target;
+    }
+
+    // Splits every non-empty file in paths. Returns false if a file cannot be
+    // sized; the splits planned so far are kept.
+    static bool plan(const std::vector<std::string>& paths, uint64_t splitBytes, std::vector<InputSplit>& splits) {
+        if (splitBytes == 0) {
+            splitBytes = kMinSplitBytes;
+        }
+        bool ok = true;
+        for (const std::string& path : paths) {
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(path, ec);
+            if (ec) {
+                ErrorHandler::reportError("Could not stat input file " + path + ".");
+                ok = false;
+                continue;
+            }
+            for (uint64_t offset = 0; offset < size; offset += splitBytes) {
+                uint64_t length = size - offset < splitBytes ? size - offset : splitBytes;
+                splits.push_back(InputSplit{path, offset, length});
+            }
+        }
+        return ok;
+    }
+
+    static uint64_t total_bytes(const std::vector<InputSplit>& splits) {
+        uint64_t total = 0;
+        for (const InputSplit& split : splits) {
+            total += split.length;
+        }
+        return total;
+    }
+};
@@ -0,0 +1,563 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include "ERROR_Handler.h"
+#include "FlatStringMap.h"
+#include "Hash.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+
+// On-disk inverted index: word -> [(document, positions)], laid out so a
+// reader maps the file and searches it in place, with nothing to parse on
+// load. All integers are little-endian; offsets are from the file start.
+//
+//     header     "MRINDEX1" | documents | terms | document table offset |
+//                term table offset | strings offset | postings offset |
+//                file size                              (8 x 8 bytes)
+//     documents  per document: name offset, name length  (8 + 8 bytes)
+//     terms      per term, sorted by word: word offset, word length,
+//                postings offset, postings length, document frequency,
+//                unused                                 (6 x 8 bytes)
+//     strings    document names and words
+//     postings   per term, per document in ascending order:
+//                varint(document delta) | varint(positions) |
+//                varint(position delta)...
+//
+// Positions are word ordinals within the document, counted the way the
+// word count tokenizes (Tokenizer.h); words are stored in that cleaned form.
+// They are 32-bit, so a document may hold at most 2^32 words.
+struct IndexFormat {
+    static constexpr char kMagic[8] = {'M', 'R', 'I', 'N', 'D', 'E', 'X', '1'};
+    static constexpr size_t kHeaderBytes = 64;
+    static constexpr size_t kDocumentBytes = 16;
+    static constexpr size_t kTermBytes = 48;
+
+    static void put64(std::string& out, uint64_t value) {
+        char bytes[8];
+        for (int i = 0; i < 8; ++i) {
+            bytes[i] = static_cast<char>(value >> (8 * i));
+        }
+        out.append(bytes, 8);
+    }
+
+    static uint64_t get64(const char* at) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; --i) {
+            value = (value << 8) | static_cast<uint8_t>(at[i]);
+        }
+        return value;
+    }
+};
+
+// Builds an index over a set of documents as a MapReduce job. Map tasks
+// (one per input split) tokenize their byte range and spill, per word, the
+// split number and the delta-coded ordinals of the word within the split.
+// Once every split's word count is known, each split's first ordinal within
+// its document follows, so the reducers (one per hash partition) can turn
+// split ordinals into document positions, sort them, and encode the posting
+// lists. The partitions' terms are then merged in word order into one file.
+class InvertedIndex {
+public:
+    static constexpr size_t kPartitionsPerWorker = 4;
+
+    explicit InvertedIndex(ThreadPool& pool = ThreadPool::getInstance())
+        : threadPool(pool) {}
+
+    // Indexes paths (document i is paths[i], stored under names[i]) and
+    // writes the index to indexPath. Intermediate files go to tempFolder;
+    // splitBytes of 0 sizes the splits for the pool.
+    bool build(const std::vector<std::string>& paths, const std::vector<std::string>& names,
+               const std::string& tempFolder, const std::string& indexPath, uint64_t splitBytes = 0) {
+        if (names.size() != paths.size()) {
+            ErrorHandler::reportError("Every indexed document needs a name.");
+            return false;
+        }
+        std::vector<InputSplit> splits;
+        std::vector<uint32_t> documents;
+        uint64_t totalBytes = 0;
+        for (const std::string& path : paths) {
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(path, ec);
+            totalBytes += ec ? 0 : size;
+        }
+        if (splitBytes == 0) {
+            splitBytes = InputSplit::default_split_bytes(totalBytes, threadPool.size());
+        }
+        for (size_t d = 0; d < paths.size(); ++d) {
+            if (!InputSplit::plan({paths[d]}, splitBytes, splits)) {
+                return false;
+            }
+            documents.resize(splits.size(), static_cast<uint32_t>(d));
+        }
+
+        size_t partitions = threadPool.size() * kPartitionsPerWorker;
+        std::vector<std::string> spillPaths;
+        for (size_t p = 0; p < partitions; ++p) {
+            spillPaths.push_back(tempFolder + "/index_spill_" + std::to_string(p) + ".bin");
+        }
+        std::vector<uint64_t> splitWords(splits.size(), 0);
+        bool ok = map_phase(splits, spillPaths, splitWords);
+
+        std::vector<uint64_t> firstOrdinal;
+        ok = ok && first_ordinals(documents, splitWords, names, firstOrdinal);
+
+        std::vector<std::vector<Term>> partitionTerms(partitions);
+        ok = ok && reduce_phase(spillPaths, documents, firstOrdinal, partitionTerms);
+        std::error_code ec;
+        for (const std::string& path : spillPaths) {
+            std::filesystem::remove(path, ec);
+        }
+        return ok && write_index(names, partitionTerms, indexPath);
+    }
+
+    // Distinct words in the last index built.
+    uint64_t term_count() const {
+        return termCount;
+    }
+
+    // First ordinal of every split within its document (documents[t] is
+    // split t's document), from the splits' word counts. Fails when a
+    // document has more words than 32-bit positions can number.
+    static bool first_ordinals(const std::vector<uint32_t>& documents, const std::vector<uint64_t>& splitWords,
+                               const std::vector<std::string>& names, std::vector<uint64_t>& firstOrdinal) {
+        firstOrdinal.assign(splitWords.size(), 0);
+        for (size_t t = 0; t < splitWords.size(); ++t) {
+            if (t > 0 && documents[t] == documents[t - 1]) {
+                firstOrdinal[t] = firstOrdinal[t - 1] + splitWords[t - 1];
+            }
+            if (firstOrdinal[t] + splitWords[t] > kMaxDocumentWords) {
+                ErrorHandler::reportError("Document " + names[documents[t]] + " has more than 2^32 words to index.");
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Words buffered per map task before their positions are spilled.
+    static constexpr size_t kFlushPositions = 1 << 20;
+    static constexpr uint64_t kMaxDocumentWords = 1ull << 32;
+
+    struct Term {
+        std::string word;
+        uint64_t documents = 0;
+        std::string postings;
+    };
+
+    bool map_phase(const std::vector<InputSplit>& splits, const std::vector<std::string>& spillPaths,
+                   std::vector<uint64_t>& splitWords) {
+        std::vector<RecordWriter> writers(spillPaths.size());
+        std::vector<std::mutex> locks(spillPaths.size());
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            if (!writers[p].open(spillPaths[p])) {
+                return false;
+            }
+        }
+
+        std::vector<char> succeeded(splits.size(), 0);
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([&writers, &locks, &splits, &splitWords, &succeeded, t]() {
+                Metrics::TaskScope task("index_map", t);
+                MappedFile file;
+                if (!file.open(splits[t].path)) {
+                    return;
+                }
+                std::string_view text = MappedFile::line_range(file.view(), splits[t].offset, splits[t].length);
+                FlatStringMap<std::vector<uint32_t>> positions;
+                std::vector<std::string> buckets(writers.size());
+                size_t buffered = 0;
+                uint64_t ordinal = 0;  // may pass 2^32; build() rejects the document then
+                auto flush = [&]() {
+                    for (const auto& kv : positions) {
+                        std::string& bucket = buckets[Hash::fnv1a(kv.first) % buckets.size()];
+                        RecordWriter::append_varint(bucket, kv.first.size());
+                        bucket.append(kv.first.data(), kv.first.size());
+                        RecordWriter::append_varint(bucket, t);
+                        RecordWriter::append_varint(bucket, kv.second.size());
+                        uint32_t previous = 0;
+                        for (uint32_t position : kv.second) {
+                            RecordWriter::append_varint(bucket, position - previous);
+                            previous = position;
+                        }
+                    }
+                    for (size_t p = 0; p < buckets.size(); ++p) {
+                        if (!buckets[p].empty()) {
+                            std::lock_guard<std::mutex> lock(locks[p]);
+                            writers[p].write_encoded(buckets[p]);
+                        }
+                        buckets[p].clear();
+                    }
+                    positions.clear();
+                    buffered = 0;
+                };
+
+                std::string scratch;
+                while (!text.empty()) {
+                    std::string_view slice = MappedFile::next_chunk(text, 1 << 20);
+                    Tokenizer::for_each_word(slice, scratch, [&positions, &ordinal, &buffered](std::string_view word) {
+                        positions[word].push_back(static_cast<uint32_t>(ordinal++));
+                        ++buffered;
+                    });
+                    text.remove_prefix(slice.size());
+                    if (buffered >= kFlushPositions) {
+                        flush();
+                    }
+                }
+                flush();
+                splitWords[t] = ordinal;
+                Metrics::add(Metrics::BytesRead, splits[t].length);
+                Metrics::add(Metrics::RecordsIn, ordinal);
+                succeeded[t] = 1;
+            });
+        }
+        threadPool.wait();
+
+        bool ok = true;
+        for (size_t p = 0; p < writers.size(); ++p) {
+            ok = writers[p].close() && ok;
+        }
+        for (char done : succeeded) {
+            ok = ok && done;
+        }
+        return ok;
+    }
+
+    bool reduce_phase(const std::vector<std::string>& spillPaths, const std::vector<uint32_t>& documents,
+                      const std::vector<uint64_t>& firstOrdinal, std::vector<std::vector<Term>>& terms) {
+        std::vector<char> succeeded(spillPaths.size(), 0);
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            threadPool.enqueueTask([&spillPaths, &documents, &firstOrdinal, &terms, &succeeded, p]() {
+                Metrics::TaskScope task("index_reduce", p);
+                RecordReader reader;
+                if (!reader.open(spillPaths[p])) {
+                    return;
+                }
+                // Occurrences per word as (document << 32 | position)
+                FlatStringMap<std::vector<uint64_t>> occurrences;
+                std::string_view word;
+                uint64_t split = 0;
+                std::vector<uint64_t> deltas;
+                auto decode = [&word, &split, &deltas](const char*& pos, const char* end) {
+                    const char* q = pos;
+                    uint64_t length;
+                    uint64_t count;
+                    if (!RecordReader::read_varint(q, end, length) || static_cast<uint64_t>(end - q) < length) {
+                        return false;
+                    }
+                    std::string_view key(q, static_cast<size_t>(length));
+                    q += length;
+                    if (!RecordReader::read_varint(q, end, split) || !RecordReader::read_varint(q, end, count) ||
+                        static_cast<uint64_t>(end - q) < count) {
+                        return false;
+                    }
+                    deltas.resize(static_cast<size_t>(count));
+                    for (uint64_t& delta : deltas) {
+                        if (!RecordReader::read_varint(q, end, delta)) {
+                            return false;
+                        }
+                    }
+                    word = key;
+                    pos = q;
+                    return true;
+                };
+                uint64_t records = 0;
+                bool valid = true;
+                while (reader.next_with(decode)) {
+                    ++records;
+                    if (split >= documents.size()) {
+                        valid = false;
+                        break;
+                    }
+                    std::vector<uint64_t>& list = occurrences[word];
+                    uint64_t document = static_cast<uint64_t>(documents[split]) << 32;
+                    uint64_t position = firstOrdinal[split];
+                    for (uint64_t delta : deltas) {
+                        position += delta;
+                        list.push_back(document | position);
+                    }
+                }
+                Metrics::add(Metrics::BytesRead, reader.bytes_read());
+                Metrics::add(Metrics::RecordsIn, records);
+                if (!valid || reader.truncated()) {
+                    ErrorHandler::reportError("File " + spillPaths[p] + " holds a malformed posting record.");
+                    return;
+                }
+
+                std::vector<Term>& out = terms[p];
+                out.reserve(occurrences.size());
+                for (const auto& kv : occurrences) {
+                    std::vector<uint64_t> list = kv.second;
+                    std::sort(list.begin(), list.end());
+                    Term term;
+                    term.word = std::string(kv.first);
+                    encode_postings(list, term);
+                    out.push_back(std::move(term));
+                }
+                std::sort(out.begin(), out.end(), [](const Term& a, const Term& b) { return a.word < b.word; });
+                Metrics::add(Metrics::RecordsOut, out.size());
+                succeeded[p] = 1;
+            });
+        }
+        threadPool.wait();
+
+        bool ok = true;
+        for (char done : succeeded) {
+            ok = ok && done;
+        }
+        return ok;
+    }
+
+    // Sorted (document << 32 | position) list to the postings encoding.
+    static void encode_postings(const std::vector<uint64_t>& list, Term& term) {
+        uint64_t previousDocument = 0;
+        size_t i = 0;
+        while (i < list.size()) {
+            uint64_t document = list[i] >> 32;
+            size_t end = i;
+            while (end < list.size() && (list[end] >> 32) == document) {
+                ++end;
+            }
+            RecordWriter::append_varint(term.postings, document - previousDocument);
+            RecordWriter::append_varint(term.postings, end - i);
+            uint64_t previous = 0;
+            for (; i < end; ++i) {
+                uint64_t position = list[i] & 0xFFFFFFFFu;
+                RecordWriter::append_varint(term.postings, position - previous);
+                previous = position;
+            }
+            previousDocument = document;
+            ++term.documents;
+        }
+    }
+
+    bool write_index(const std::vector<std::string>& names, std::vector<std::vector<Term>>& partitions,
+                     const std::string& indexPath) {
+        Metrics::TaskScope task("index_write", 0);
+        std::vector<const Term*> ordered;
+        for (const auto& partition : partitions) {
+            for (const Term& term : partition) {
+                ordered.push_back(&term);
+            }
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const Term* a, const Term* b) { return a->word < b->word; });
+        termCount = ordered.size();
+
+        uint64_t documentTable = IndexFormat::kHeaderBytes;
+        uint64_t termTable = documentTable + names.size() * IndexFormat::kDocumentBytes;
+        uint64_t strings = termTable + ordered.size() * IndexFormat::kTermBytes;
+        uint64_t stringBytes = 0;
+        for (const std::string& name : names) {
+            stringBytes += name.size();
+        }
+        for (const Term* term : ordered) {
+            stringBytes += term->word.size();
+        }
+        uint64_t postings = strings + stringBytes;
+        uint64_t postingBytes = 0;
+        for (const Term* term : ordered) {
+            postingBytes += term->postings.size();
+        }
+
+        std::string tables;
+        tables.append(IndexFormat::kMagic, sizeof(IndexFormat::kMagic));
+        for (uint64_t field : {static_cast<uint64_t>(names.size()), static_cast<uint64_t>(ordered.size()), documentTable,
+                               termTable, strings, postings, postings + postingBytes}) {
+            IndexFormat::put64(tables, field);
+        }
+        uint64_t stringAt = strings;
+        for (const std::string& name : names) {
+            IndexFormat::put64(tables, stringAt);
+            IndexFormat::put64(tables, name.size());
+            stringAt += name.size();
+        }
+        uint64_t postingAt = postings;
+        for (const Term* term : ordered) {
+            for (uint64_t field : {stringAt, static_cast<uint64_t>(term->word.size()), postingAt,
+                                   static_cast<uint64_t>(term->postings.size()), term->documents, uint64_t(0)}) {
+                IndexFormat::put64(tables, field);
+            }
+            stringAt += term->word.size();
+            postingAt += term->postings.size();
+        }
+
+        std::ofstream out(indexPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            ErrorHandler::reportError("Could not open " + indexPath + " for writing.");
+            return false;
+        }
+        out.write(tables.data(), static_cast<std::streamsize>(tables.size()));
+        for (const std::string& name : names) {
+            out.write(name.data(), static_cast<std::streamsize>(name.size()));
+        }
+        for (const Term* term : ordered) {
+            out.write(term->word.data(), static_cast<std::streamsize>(term->word.size()));
+        }
+        for (const Term* term : ordered) {
+            out.write(term->postings.data(), static_cast<std::streamsize>(term->postings.size()));
+        }
+        if (!out.flush()) {
+            ErrorHandler::reportError("Could not write " + indexPath + ".");
+            return false;
+        }
+        return true;
+    }
+
+    ThreadPool& threadPool;
+    uint64_t termCount = 0;
+};
+
+// Cursor over one posting list: next() steps to the next document.
+class PostingList {
+public:
+    PostingList() = default;
+    PostingList(std::string_view bytes, uint64_t documents) : bytes(bytes), documentCount(documents) {}
+
+    bool empty() const {
+        return documentCount == 0;
+    }
+
+    // Documents that contain the word.
+    uint64_t document_frequency() const {
+        return documentCount;
+    }
+
+    bool next() {
+        const char* pos = bytes.data() + offset;
+        const char* end = bytes.data() + bytes.size();
+        uint64_t delta;
+        uint64_t count;
+        if (!RecordReader::read_varint(pos, end, delta) || !RecordReader::read_varint(pos, end, count) ||
+            static_cast<uint64_t>(end - pos) < count) {
+            return false;
+        }
+        positionList.resize(static_cast<size_t>(count));
+        uint64_t position = 0;
+        for (uint32_t& value : positionList) {
+            uint64_t step;
+            if (!RecordReader::read_varint(pos, end, step)) {
+                return false;
+            }
+            position += step;
+            value = static_cast<uint32_t>(position);
+        }
+        currentDocument += delta;
+        offset = static_cast<size_t>(pos - bytes.data());
+        return true;
+    }
+
+    uint32_t document() const {
+        return static_cast<uint32_t>(currentDocument);
+    }
+
+    // Word ordinals of the current document, ascending.
+    const std::vector<uint32_t>& positions() const {
+        return positionList;
+    }
+
+private:
+    std::string_view bytes;
+    uint64_t documentCount = 0;
+    size_t offset = 0;
+    uint64_t currentDocument = 0;
+    std::vector<uint32_t> positionList;
+};
+
+// Query side: maps an index file and looks words up by binary search over
+// the term table, in place.
+class IndexReader {
+public:
+    bool open(const std::string& path) {
+        if (!file.open(path)) {
+            return false;
+        }
+        std::string_view data = file.view();
+        if (data.size() < IndexFormat::kHeaderBytes ||
+            std::memcmp(data.data(), IndexFormat::kMagic, sizeof(IndexFormat::kMagic)) != 0) {
+            ErrorHandler::reportError(path + " is not an index file.");
+            return false;
+        }
+        const char* header = data.data() + sizeof(IndexFormat::kMagic);
+        documentCount = IndexFormat::get64(header);
+        termCount = IndexFormat::get64(header + 8);
+        documentTable = IndexFormat::get64(header + 16);
+        termTable = IndexFormat::get64(header + 24);
+        uint64_t fileSize = IndexFormat::get64(header + 48);
+        if (fileSize != data.size() || documentTable > data.size() || termTable > data.size() ||
+            (data.size() - documentTable) / IndexFormat::kDocumentBytes < documentCount ||
+            (data.size() - termTable) / IndexFormat::kTermBytes < termCount) {
+            ErrorHandler::reportError(path + " is truncated or corrupt.");
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t document_count() const {
+        return documentCount;
+    }
+
+    uint64_t term_count() const {
+        return termCount;
+    }
+
+    std::string_view document(uint64_t id) const {
+        const char* entry = file.view().data() + documentTable + id * IndexFormat::kDocumentBytes;
+        return slice(IndexFormat::get64(entry), IndexFormat::get64(entry + 8));
+    }
+
+    std::string_view word(uint64_t term) const {
+        const char* entry = term_entry(term);
+        return slice(IndexFormat::get64(entry), IndexFormat::get64(entry + 8));
+    }
+
+    // Postings of word (in the tokenizer's cleaned form); empty if absent.
+    PostingList find(std::string_view word) const {
+        uint64_t low = 0;
+        uint64_t high = termCount;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            int order = this->word(middle).compare(word);
+            if (order == 0) {
+                const char* entry = term_entry(middle);
+                return PostingList(slice(IndexFormat::get64(entry + 16), IndexFormat::get64(entry + 24)),
+                                   IndexFormat::get64(entry + 32));
+            }
+            if (order < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return PostingList();
+    }
+
+private:
+    const char* term_entry(uint64_t term) const {
+        return file.view().data() + termTable + term * IndexFormat::kTermBytes;
+    }
+
+    // Bounds-checked view of the file, so a corrupt entry reads as empty.
+    std::string_view slice(uint64_t offset, uint64_t length) const {
+        std::string_view data = file.view();
+        if (offset > data.size() || length > data.size() - offset) {
+            return std::string_view();
+        }
+        return data.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+    }
+
+    MappedFile file;
+    uint64_t documentCount = 0;
+    uint64_t termCount = 0;
+    uint64_t documentTable = 0;
+    uint64_t termTable = 0;
+};
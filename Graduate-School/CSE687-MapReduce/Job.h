@@ -0,0 +1,293 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <filesystem>
+#include <type_traits>
+#include <cstdint>
+#include "BlockCodec.h"
+#include "Combiner.h"
+#include "ERROR_Handler.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "Serializer.h"
+#include "ThreadPool.h"
+
+// Pass as the combiner of a Job whose values must all reach the reducer.
+struct NoCombine {};
+
+struct JobOptions {
+    std::string folder = ".";       // where the shuffle files go
+    std::string name = "job";       // shuffle files are <folder>/<name>_<partition>.bin
+    size_t partitions = 0;          // 0 picks kPartitionsPerWorker per pool worker
+    size_t combinerEntries = Combiner::kDefaultEntries;
+    BlockCodec::Codec codec = RecordWriter::default_codec();
+};
+
+// Typed MapReduce job over text input. Keys and values keep their own types
+// from map to output; the shuffle stores them with Serializer<K> and
+// Serializer<V> and routes them with Hasher<K> (see Serializer.h).
+//
+//     map(path, line, emit)     called for every line of every split;
+//                               emit(K, V) any number of times
+//     combine(V& into, V&&)     folds two values of one key, map side and
+//                               reduce side, or NoCombine to keep them all
+//     reduce(const K&, std::vector<V>&&) -> V
+//                               the final value of a key; with a combiner
+//                               the vector holds the single combined value
+//
+// The phases follow the built-in word count: one map task per split with a
+// bounded table of combined values that spills to hash partitions, then one
+// reduce task per partition. Shuffle files are removed when run() returns.
+//
+//     auto job = make_job<std::string, uint64_t>(
+//         [](std::string_view, std::string_view line, auto& emit) { ... },
+//         [](uint64_t& into, uint64_t&& value) { into += value; },
+//         [](const std::string&, std::vector<uint64_t>&& values) { return values.front(); });
+template <typename K, typename V, typename MapFn, typename CombineFn, typename ReduceFn>
+class Job {
+public:
+    static constexpr size_t kPartitionsPerWorker = 4;
+
+    Job(MapFn map, CombineFn combine, ReduceFn reduce, JobOptions options = JobOptions(),
+        ThreadPool& pool = ThreadPool::getInstance())
+        : mapFn(std::move(map)), combineFn(std::move(combine)), reduceFn(std::move(reduce)),
+          options(std::move(options)), threadPool(pool) {}
+
+    // Runs the job over splits and returns one (key, value) per distinct key
+    // in no particular order. Returns false if an input, shuffle file or
+    // task fails.
+    bool run(const std::vector<InputSplit>& splits, std::vector<std::pair<K, V>>& output) {
+        output.clear();
+        size_t partitions = options.partitions > 0 ? options.partitions : threadPool.size() * kPartitionsPerWorker;
+        std::vector<std::string> paths;
+        for (size_t p = 0; p < partitions; ++p) {
+            paths.push_back(options.folder + "/" + options.name + "_" + std::to_string(p) + ".bin");
+        }
+
+        bool ok = map_phase(splits, paths);
+        std::vector<std::vector<std::pair<K, V>>> results(partitions);
+        ok = ok && reduce_phase(paths, results);
+        std::error_code ec;
+        for (const std::string& path : paths) {
+            std::filesystem::remove(path, ec);
+        }
+        if (!ok) {
+            return false;
+        }
+
+        size_t total = 0;
+        for (const auto& partition : results) {
+            total += partition.size();
+        }
+        output.reserve(total);
+        for (auto& partition : results) {
+            std::move(partition.begin(), partition.end(), std::back_inserter(output));
+        }
+        return true;
+    }
+
+private:
+    static constexpr bool kCombines = !std::is_same_v<CombineFn, NoCombine>;
+    static constexpr size_t kBucketBytes = 1 << 20;
+
+    struct Shuffle {
+        std::vector<RecordWriter> writers;
+        std::vector<std::mutex> locks;
+
+        explicit Shuffle(size_t partitions) : writers(partitions), locks(partitions) {}
+    };
+
+    // The emit handed to map: combines into a bounded table (or encodes
+    // straight away without a combiner) and appends whole buckets to the
+    // shuffle files, one lock per partition per flush.
+    class Emitter {
+    public:
+        Emitter(const Job& job, Shuffle& shuffle)
+            : job(job), shuffle(shuffle), buckets(shuffle.writers.size()) {}
+
+        void operator()(K key, V value) {
+            if constexpr (kCombines) {
+                auto found = table.find(key);
+                if (found != table.end()) {
+                    job.combineFn(found->second, std::move(value));
+                    return;
+                }
+                if (table.size() >= job.options.combinerEntries) {
+                    flush_table();
+                }
+                table.emplace(std::move(key), std::move(value));
+            } else {
+                encode(key, value);
+            }
+        }
+
+        void flush() {
+            flush_table();
+            write_buckets();
+        }
+
+    private:
+        void flush_table() {
+            Metrics::add(Metrics::RecordsOut, table.size());
+            for (const auto& kv : table) {
+                encode(kv.first, kv.second);
+            }
+            table.clear();
+        }
+
+        void encode(const K& key, const V& value) {
+            std::string& bucket = buckets[Hasher<K>::hash(key) % buckets.size()];
+            size_t before = bucket.size();
+            Serializer<K>::write(bucket, key);
+            Serializer<V>::write(bucket, value);
+            bucketBytes += bucket.size() - before;
+            if (bucketBytes >= kBucketBytes) {
+                write_buckets();
+            }
+        }
+
+        void write_buckets() {
+            for (size_t p = 0; p < buckets.size(); ++p) {
+                if (buckets[p].empty()) {
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(shuffle.locks[p]);
+                    shuffle.writers[p].write_encoded(buckets[p]);
+                }
+                buckets[p].clear();
+            }
+            bucketBytes = 0;
+        }
+
+        const Job& job;
+        Shuffle& shuffle;
+        std::unordered_map<K, V, Hasher<K>> table;
+        std::vector<std::string> buckets;
+        size_t bucketBytes = 0;
+    };
+
+    bool map_phase(const std::vector<InputSplit>& splits, const std::vector<std::string>& paths) {
+        Shuffle shuffle(paths.size());
+        for (size_t p = 0; p < paths.size(); ++p) {
+            if (!shuffle.writers[p].open(paths[p], 1 << 16, options.codec)) {
+                return false;
+            }
+        }
+
+        std::vector<char> succeeded(splits.size(), 0);
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([this, &shuffle, &succeeded, &split = splits[t], t]() {
+                Metrics::TaskScope task("job_map", t);
+                MappedFile file;
+                if (!file.open(split.path)) {
+                    return;
+                }
+                Emitter emit(*this, shuffle);
+                std::string_view text = MappedFile::line_range(file.view(), split.offset, split.length);
+                uint64_t lines = 0;
+                MappedFile::for_each_line(text, [this, &split, &emit, &lines](std::string_view line) {
+                    ++lines;
+                    mapFn(std::string_view(split.path), line, emit);
+                });
+                emit.flush();
+                Metrics::add(Metrics::BytesRead, text.size());
+                Metrics::add(Metrics::RecordsIn, lines);
+                succeeded[t] = 1;
+            });
+        }
+        threadPool.wait();
+
+        bool ok = true;
+        for (size_t p = 0; p < paths.size(); ++p) {
+            ok = shuffle.writers[p].close() && ok;
+        }
+        for (char done : succeeded) {
+            ok = ok && done;
+        }
+        return ok;
+    }
+
+    bool reduce_phase(const std::vector<std::string>& paths, std::vector<std::vector<std::pair<K, V>>>& results) {
+        std::vector<char> succeeded(paths.size(), 0);
+        for (size_t p = 0; p < paths.size(); ++p) {
+            threadPool.enqueueTask([this, &paths, &results, &succeeded, p]() {
+                Metrics::TaskScope task("job_reduce", p);
+                RecordReader reader;
+                if (!reader.open(paths[p])) {
+                    return;
+                }
+                std::unordered_map<K, std::vector<V>, Hasher<K>> groups;
+                K key{};
+                V value{};
+                uint64_t records = 0;
+                auto decode = [&key, &value](const char*& pos, const char* end) {
+                    const char* p = pos;
+                    if (!Serializer<K>::read(p, end, key) || !Serializer<V>::read(p, end, value)) {
+                        return false;
+                    }
+                    pos = p;
+                    return true;
+                };
+                while (reader.next_with(decode)) {
+                    ++records;
+                    std::vector<V>& values = groups[key];
+                    if (kCombines && !values.empty()) {
+                        combine(values.front(), std::move(value));
+                    } else {
+                        values.push_back(std::move(value));
+                    }
+                }
+                Metrics::add(Metrics::BytesRead, reader.bytes_read());
+                Metrics::add(Metrics::RecordsIn, records);
+                if (reader.truncated()) {
+                    ErrorHandler::reportError("File " + paths[p] + " ends in the middle of a record.");
+                    return;
+                }
+                results[p].reserve(groups.size());
+                for (auto& group : groups) {
+                    results[p].emplace_back(group.first, reduceFn(group.first, std::move(group.second)));
+                }
+                Metrics::add(Metrics::RecordsOut, results[p].size());
+                succeeded[p] = 1;
+            });
+        }
+        threadPool.wait();
+
+        bool ok = true;
+        for (char done : succeeded) {
+            ok = ok && done;
+        }
+        return ok;
+    }
+
+    void combine(V& into, V&& value) const {
+        if constexpr (kCombines) {
+            combineFn(into, std::move(value));
+        }
+    }
+
+    MapFn mapFn;
+    CombineFn combineFn;
+    ReduceFn reduceFn;
+    JobOptions options;
+    ThreadPool& threadPool;
+};
+
+// Deduces the function types so lambdas can be passed directly; only the
+// key and value types are spelled out.
+template <typename K, typename V, typename MapFn, typename CombineFn, typename ReduceFn>
+Job<K, V, MapFn, CombineFn, ReduceFn> make_job(MapFn map, CombineFn combine, ReduceFn reduce,
+                                               JobOptions options = JobOptions(),
+                                               ThreadPool& pool = ThreadPool::getInstance()) {
+    return Job<K, V, MapFn, CombineFn, ReduceFn>(std::move(map), std::move(combine), std::move(reduce),
+                                                 std::move(options), pool);
+}
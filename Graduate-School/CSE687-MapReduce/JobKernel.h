@@ -0,0 +1,63 @@
+#ifndef JOB_KERNEL_H
+#define JOB_KERNEL_H
+
+/*
+ * Stable C ABI for map/reduce job kernels loaded at runtime (see
+ * KernelLibrary.h). A kernel is a shared library exporting
+ *
+ *     const mr_kernel* mapreduce_kernel_v1(void);
+ *
+ * Both entry points work on whole batches, so the driver makes one indirect
+ * call per batch rather than per record. Every buffer crossing the boundary
+ * uses the RecordIO encoding:
+ *
+ *     record: varint(key length) | key bytes | varint(count)
+ *     group:  varint(key length) | key bytes | varint(n) | n x varint(value)
+ *
+ * with LEB128 varints. Buffers passed to a kernel are only valid for the
+ * duration of the call; buffers passed to emit are copied before it returns.
+ * Kernels may be called from several threads at once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#define MR_KERNEL_EXPORT __declspec(dllexport)
+#elif defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+#define MR_KERNEL_EXPORT __attribute__((visibility("default")))
+#else
+#define MR_KERNEL_EXPORT
+#endif
+
+#define MR_KERNEL_ABI_VERSION 1
+#define MR_KERNEL_ENTRY_POINT "mapreduce_kernel_v1"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Receives a buffer of encoded records. */
+typedef void (*mr_emit_fn)(void* ctx, const char* records, size_t size);
+
+typedef struct mr_kernel {
+    uint32_t abi_version;  /* MR_KERNEL_ABI_VERSION */
+    const char* name;
+
+    /* Maps a line-aligned slice of raw input text and emits (key, count)
+     * records; a key may be emitted more than once. Returns 0 on success. */
+    int (*map_batch)(const char* text, size_t size, mr_emit_fn emit, void* ctx);
+
+    /* Reduces a buffer of complete groups (every value of each key) and
+     * emits one record per key. NULL means the driver sums the values.
+     * Returns 0 on success. */
+    int (*reduce_batch)(const char* groups, size_t size, mr_emit_fn emit, void* ctx);
+} mr_kernel;
+
+typedef const mr_kernel* (*mr_kernel_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include "ERROR_Handler.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Checkpoint log of a job in its temp folder: which tasks have finished,
+// and the output files each one left behind with their sizes and content
+// hashes:
+//
+//     mapreduce-job <version> <plan>
+//     <kind> <task> <files> [<file name> <size> <hash>]...
+//
+// plan is a hash of everything that decides the tasks' outputs (splits,
+// input sizes and mtimes, partitions, kernel, codec); a log written for
+// another plan is discarded. A line is appended and flushed as each task
+// completes, so a job that dies keeps every task finished before it. A
+// restart re-hashes the listed files and skips the tasks whose files are
+// intact. A torn last line (the crash hit mid-write) ends the log.
+class JobManifest {
+public:
+    // Bump whenever a task's output format changes.
+    static constexpr int kFormatVersion = 1;
+
+    struct FileCheck {
+        uint64_t size = 0;
+        uint64_t hash = 0;
+    };
+
+    explicit JobManifest(std::string folder, ThreadPool& pool = ThreadPool::getInstance())
+        : folder(std::move(folder)), threadPool(pool) {}
+
+    std::string path() const {
+        return folder + "/job_manifest.txt";
+    }
+
+    // Loads the tasks an earlier run of the same plan recorded. Nothing is
+    // written until start().
+    void open(uint64_t plan) {
+        this->plan = plan;
+        tasks.clear();
+        std::ifstream in(path());
+        std::string line;
+        std::string tag;
+        int version = 0;
+        uint64_t recordedPlan = 0;
+        if (!in || !std::getline(in, line)) {
+            return;
+        }
+        std::istringstream header(line);
+        if (!(header >> tag >> version >> recordedPlan) || tag != kManifestTag || version != kFormatVersion ||
+            recordedPlan != plan) {
+            return;
+        }
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            uint64_t task = 0;
+            size_t count = 0;
+            if (!(fields >> kind >> task >> count) || count > kMaxFilesPerTask) {
+                break;
+            }
+            std::vector<std::pair<std::string, FileCheck>> files(count);
+            bool complete = true;
+            for (auto& file : files) {
+                complete = complete && static_cast<bool>(fields >> file.first >> file.second.size >> file.second.hash);
+            }
+            if (!complete) {
+                break;
+            }
+            tasks[{kind, task}] = std::move(files);
+        }
+    }
+
+    // Flags tasks [0, count) of kind that are recorded and whose files still
+    // have the recorded size and hash. Files are hashed in parallel; tasks
+    // that fail the check are forgotten.
+    std::vector<char> verify(const std::string& kind, size_t count) {
+        std::vector<char> done(count, 0);
+        for (size_t t = 0; t < count; ++t) {
+            auto found = tasks.find({kind, t});
+            if (found == tasks.end()) {
+                continue;
+            }
+            const auto* files = &found->second;
+            threadPool.enqueueTask([this, files, &done, t]() {
+                for (const auto& file : *files) {
+                    std::string filePath = folder + "/" + file.first;
+                    std::error_code ec;
+                    FileCheck actual;
+                    if (!std::filesystem::exists(filePath, ec) || !check(filePath, actual) ||
+                        actual.size != file.second.size || actual.hash != file.second.hash) {
+                        return;
+                    }
+                }
+                done[t] = 1;
+            });
+        }
+        threadPool.wait();
+        for (size_t t = 0; t < count; ++t) {
+            if (!done[t]) {
+                tasks.erase({kind, t});
+            }
+        }
+        return done;
+    }
+
+    // Drops every task of kind, e.g. reduce tasks whose inputs are redone.
+    void forget(const std::string& kind) {
+        for (auto it = tasks.begin(); it != tasks.end();) {
+            it = it->first.first == kind ? tasks.erase(it) : std::next(it);
+        }
+    }
+
+    // Rewrites the log with the tasks still known (next to the old one,
+    // then renamed over it) and opens it for record().
+    bool start() {
+        std::string target = path();
+        std::string staged = target + ".tmp";
+        {
+            std::ofstream out(staged, std::ios::trunc);
+            if (!out) {
+                ErrorHandler::reportError("Could not open " + staged + " for writing.");
+                return false;
+            }
+            out << kManifestTag << ' ' << kFormatVersion << ' ' << plan << '\n';
+            for (const auto& kv : tasks) {
+                out << line(kv.first.first, kv.first.second, kv.second);
+            }
+            if (!out.flush()) {
+                ErrorHandler::reportError("Could not write " + staged + ".");
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(staged, target, ec);
+        if (ec) {
+            ErrorHandler::reportError("Could not replace " + target + ".");
+            return false;
+        }
+        log.open(target, std::ios::app);
+        if (!log) {
+            ErrorHandler::reportError("Could not open " + target + " for appending.");
+            return false;
+        }
+        return true;
+    }
+
+    // Appends a finished task. files are names inside the folder.
+    bool record(const std::string& kind, size_t task, std::vector<std::pair<std::string, FileCheck>> files) {
+        log << line(kind, task, files);
+        if (!log.flush()) {
+            ErrorHandler::reportError("Could not append to " + path() + ".");
+            return false;
+        }
+        tasks[{kind, task}] = std::move(files);
+        return true;
+    }
+
+    // Size and content hash of a task's output file.
+    static bool check(const std::string& path, FileCheck& result) {
+        MappedFile file;
+        if (!file.open(path)) {
+            return false;
+        }
+        result.size = file.size();
+        result.hash = Hash::content(file.view());
+        return true;
+    }
+
+private:
+    static constexpr const char* kManifestTag = "mapreduce-job";
+    static constexpr size_t kMaxFilesPerTask = 1 << 16;
+
+    static std::string line(const std::string& kind, size_t task,
+                            const std::vector<std::pair<std::string, FileCheck>>& files) {
+        std::ostringstream out;
+        out << kind << ' ' << task << ' ' << files.size();
+        for (const auto& file : files) {
+            out << ' ' << file.first << ' ' << file.second.size << ' ' << file.second.hash;
+        }
+        out << '\n';
+        return out.str();
+    }
+
+    std::string folder;
+    ThreadPool& threadPool;
+    uint64_t plan = 0;
+    std::map<std::pair<std::string, uint64_t>, std::vector<std::pair<std::string, FileCheck>>> tasks;
+    std::ofstream log;
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "ERROR_Handler.h"
+#include "Combiner.h"
+#include "FlatStringMap.h"
+#include "JobKernel.h"
+#include "RecordIO.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// Runtime-loaded job kernel (see JobKernel.h for the C ABI). Loads the
+// shared library, resolves its entry point and checks the ABI version. The
+// static helpers adapt the batch calls to the driver's Combiner and
+// FlatStringMap so Mapper and Reducer only hand over whole slices/groups.
+class KernelLibrary {
+public:
+    KernelLibrary() = default;
+
+    ~KernelLibrary() {
+        close();
+    }
+
+    KernelLibrary(const KernelLibrary&) = delete;
+    KernelLibrary& operator=(const KernelLibrary&) = delete;
+
+    bool load(const std::string& path) {
+        close();
+#ifdef _WIN32
+        handle = LoadLibraryA(path.c_str());
+        if (handle == nullptr) {
+            ErrorHandler::reportError("Could not load kernel library " + path + ".");
+            return false;
+        }
+        auto entry = reinterpret_cast<mr_kernel_entry_fn>(GetProcAddress(handle, MR_KERNEL_ENTRY_POINT));
+#else
+        handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) {
+            const char* reason = ::dlerror();
+            ErrorHandler::reportError("Could not load kernel library " + path + ": " + (reason ? reason : "unknown error"));
+            return false;
+        }
+        auto entry = reinterpret_cast<mr_kernel_entry_fn>(::dlsym(handle, MR_KERNEL_ENTRY_POINT));
+#endif
+        if (entry == nullptr) {
+            ErrorHandler::reportError("Kernel library " + path + " does not export " + MR_KERNEL_ENTRY_POINT + ".");
+            close();
+            return false;
+        }
+        const mr_kernel* loaded = entry();
+        if (loaded == nullptr || loaded->abi_version != MR_KERNEL_ABI_VERSION ||
+            loaded->name == nullptr || loaded->map_batch == nullptr) {
+            ErrorHandler::reportError("Kernel library " + path + " has an incompatible ABI.");
+            close();
+            return false;
+        }
+        kernel = loaded;
+        return true;
+    }
+
+    void close() {
+        kernel = nullptr;
+        if (handle != nullptr) {
+#ifdef _WIN32
+            FreeLibrary(handle);
+#else
+            ::dlclose(handle);
+#endif
+            handle = nullptr;
+        }
+    }
+
+    const mr_kernel* get() const {
+        return kernel;
+    }
+
+    // Runs the kernel's map over text and folds the emitted records into
+    // combiner.
+    static bool map_text(const mr_kernel& kernel, std::string_view text, Combiner& combiner) {
+        Sink<Combiner> sink{combiner, true};
+        int status = kernel.map_batch(text.data(), text.size(), &Sink<Combiner>::emit, &sink);
+        return status == 0 && sink.ok;
+    }
+
+    // Encodes groups in batches of about batchBytes, runs the kernel's
+    // reduce on each batch and adds the emitted records to result. Without a
+    // reduce entry point the values are summed here.
+    static bool reduce_groups(const mr_kernel& kernel, const FlatStringMap<std::vector<uint64_t>>& groups,
+                              FlatStringMap<uint64_t>& result, size_t batchBytes = 1 << 16) {
+        if (kernel.reduce_batch == nullptr) {
+            for (const auto& group : groups) {
+                uint64_t sum = 0;
+                for (uint64_t value : group.second) {
+                    sum += value;
+                }
+                result[group.first] += sum;
+            }
+            return true;
+        }
+
+        Sink<FlatStringMap<uint64_t>> sink{result, true};
+        std::string batch;
+        auto run = [&kernel, &sink, &batch]() {
+            int status = kernel.reduce_batch(batch.data(), batch.size(), &Sink<FlatStringMap<uint64_t>>::emit, &sink);
+            batch.clear();
+            return status == 0;
+        };
+        bool ok = true;
+        for (const auto& group : groups) {
+            append_group(batch, group.first, group.second);
+            if (batch.size() >= batchBytes) {
+                ok = run() && ok;
+            }
+        }
+        if (!batch.empty()) {
+            ok = run() && ok;
+        }
+        return ok && sink.ok;
+    }
+
+    static void append_group(std::string& out, std::string_view key, const std::vector<uint64_t>& values) {
+        RecordWriter::append_varint(out, key.size());
+        out.append(key.data(), key.size());
+        RecordWriter::append_varint(out, values.size());
+        for (uint64_t value : values) {
+            RecordWriter::append_varint(out, value);
+        }
+    }
+
+private:
+    // emit callback target: decodes a record buffer into a Combiner or a
+    // count table.
+    template <typename Target>
+    struct Sink {
+        Target& target;
+        bool ok;
+
+        static void emit(void* ctx, const char* records, size_t size) {
+            Sink& self = *static_cast<Sink*>(ctx);
+            const char* pos = records;
+            const char* end = records + size;
+            std::string_view key;
+            uint64_t count;
+            while (pos < end) {
+                if (!RecordReader::read_record(pos, end, key, count)) {
+                    self.ok = false;
+                    return;
+                }
+                add(self.target, key, count);
+            }
+        }
+
+        static void add(Combiner& combiner, std::string_view key, uint64_t count) {
+            combiner.add(key, count);
+        }
+
+        static void add(FlatStringMap<uint64_t>& table, std::string_view key, uint64_t count) {
+            table[key] += count;
+        }
+    };
+
+#ifdef _WIN32
+    HMODULE handle = nullptr;
+#else
+    void* handle = nullptr;
+#endif
+    const mr_kernel* kernel = nullptr;
+};
@@ -2,11 +2,31 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include <chrono>
 #include <ctime>
+#include <cstdint>
 #include <iomanip>
 
+// Asynchronous logger. log() never takes a lock or touches a stream: each
+// thread appends to its own single-producer ring of message slots and a
+// background thread drains every ring, stamps the messages and writes each
+// batch with one write to the log file and one to stdout.
+//
+// Hot-path cost is a thread_local lookup, a copy into a slot string that
+// keeps its capacity between uses, and one release store. Timestamps come
+// from a seconds counter the drain thread refreshes, so log() never calls
+// the clock or formats a date. Messages from one thread stay in order;
+// messages from different threads are interleaved per drain batch.
+//
+// A full ring makes its producer wait for the drain thread rather than
+// drop messages. Call flush() when output must be on disk before going on
+// (the destructor and configureLogFilePath do).
 class Logger {
 public:
     static Logger& getInstance() {
@@ -15,43 +35,198 @@ public:
     }
 
     void configureLogFilePath(const std::string& path) {
+        flush();
         std::lock_guard<std::mutex> lock(mutex_);
         if (logFile_.is_open()) {
             logFile_.close();
         }
         logFile_.open(path, std::ios::app);
+        fileOpen_.store(logFile_.is_open(), std::memory_order_release);
         if (!logFile_) {
             std::cerr << "[ERROR] Could not open log file for writing: " << path << std::endl;
         }
     }
 
     void log(const std::string& message) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (!logFile_.is_open()) {
+        if (!fileOpen_.load(std::memory_order_acquire)) {
             std::cerr << "[ERROR] Log file is not configured or could not be opened." << std::endl;
             return;
         }
-        std::string timestamp = getTimestamp();
-        logFile_ << "[" << timestamp << "] " << message << std::endl;
-        std::cout << "[" << timestamp << "] " << message << std::endl;
+        Ring& ring = threadRing();
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        while (tail - ring.head.load(std::memory_order_acquire) == kRingSlots) {
+            wake();
+            std::this_thread::yield();
+        }
+        Slot& slot = ring.slots[tail & (kRingSlots - 1)];
+        slot.seconds = coarseSeconds_.load(std::memory_order_relaxed);
+        slot.text.assign(message);
+        ring.tail.store(tail + 1, std::memory_order_release);
+        if (tail - ring.head.load(std::memory_order_relaxed) >= kRingSlots / 2) {
+            wake();
+        }
+    }
+
+    // Blocks until every message logged before the call has been written.
+    void flush() {
+        std::unique_lock<std::mutex> lock(drainMutex_);
+        uint64_t target = drainPasses_ + 2;
+        wakeRequested_ = true;
+        drainCondition_.notify_all();
+        doneCondition_.wait(lock, [this, target]() { return drainPasses_ >= target || !running_; });
     }
 
 private:
-    Logger() {}
+    static constexpr size_t kRingSlots = 1024;
+    static constexpr std::chrono::milliseconds kDrainInterval{5};
+
+    struct Slot {
+        std::time_t seconds = 0;
+        std::string text;
+    };
+
+    // Single producer (the owning thread), single consumer (the drain
+    // thread). Rings are reused by later threads once their owner exits.
+    struct Ring {
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<bool> owned{true};
+        Ring* next = nullptr;
+        Slot slots[kRingSlots];
+    };
+
+    struct ThreadRing {
+        Ring* ring = nullptr;
+        ~ThreadRing() {
+            if (ring != nullptr) {
+                ring->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    Logger() {
+        coarseSeconds_.store(std::time(nullptr), std::memory_order_relaxed);
+        drainThread_ = std::thread([this]() { drainLoop(); });
+    }
+
+    // Rings are deliberately not freed: worker threads of other singletons
+    // may outlive this object and still release their ring on exit.
     ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(drainMutex_);
+            running_ = false;
+        }
+        drainCondition_.notify_all();
+        drainThread_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        drainOnce();
         if (logFile_.is_open()) {
             logFile_.close();
         }
     }
 
-    std::string getTimestamp() {
-        auto now = std::chrono::system_clock::now();
-        auto in_time_t = std::chrono::system_clock::to_time_t(now);
-        std::ostringstream ss;
-        ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %H:%M:%S");
-        return ss.str();
+    Ring& threadRing() {
+        thread_local ThreadRing local;
+        if (local.ring == nullptr) {
+            local.ring = claimRing();
+        }
+        return *local.ring;
+    }
+
+    // Takes over a ring whose owner has exited, or pushes a new one onto
+    // the lock-free list. Runs once per thread.
+    Ring* claimRing() {
+        for (Ring* ring = rings_.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+            bool expected = false;
+            if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return ring;
+            }
+        }
+        Ring* ring = new Ring();
+        ring->next = rings_.load(std::memory_order_relaxed);
+        while (!rings_.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return ring;
+    }
+
+    void wake() {
+        if (!wakeRequested_.exchange(true, std::memory_order_acq_rel)) {
+            drainCondition_.notify_one();
+        }
+    }
+
+    void drainLoop() {
+        std::unique_lock<std::mutex> lock(drainMutex_);
+        while (running_) {
+            drainCondition_.wait_for(lock, kDrainInterval, [this]() { return wakeRequested_.load() || !running_; });
+            wakeRequested_ = false;
+            lock.unlock();
+            coarseSeconds_.store(std::time(nullptr), std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> fileLock(mutex_);
+                drainOnce();
+            }
+            lock.lock();
+            ++drainPasses_;
+            doneCondition_.notify_all();
+        }
+        doneCondition_.notify_all();
+    }
+
+    // Moves everything currently in the rings into one buffer and writes it.
+    // Caller holds mutex_.
+    void drainOnce() {
+        batch_.clear();
+        for (Ring* ring = rings_.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            size_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                const Slot& slot = ring->slots[head & (kRingSlots - 1)];
+                batch_ += '[';
+                batch_ += formatTimestamp(slot.seconds);
+                batch_ += "] ";
+                batch_ += slot.text;
+                batch_ += '\n';
+            }
+            ring->head.store(head, std::memory_order_release);
+        }
+        if (batch_.empty()) {
+            return;
+        }
+        if (logFile_.is_open()) {
+            logFile_.write(batch_.data(), static_cast<std::streamsize>(batch_.size()));
+            logFile_.flush();
+        }
+        std::cout.write(batch_.data(), static_cast<std::streamsize>(batch_.size()));
+        std::cout.flush();
+    }
+
+    // Formatting is cached per second; only the drain thread calls this.
+    const std::string& formatTimestamp(std::time_t seconds) {
+        if (seconds != formattedSeconds_ || formatted_.empty()) {
+            std::ostringstream ss;
+            ss << std::put_time(std::localtime(&seconds), "%Y-%m-%d %H:%M:%S");
+            formatted_ = ss.str();
+            formattedSeconds_ = seconds;
+        }
+        return formatted_;
     }
 
     std::ofstream logFile_;
-    std::mutex mutex_;
-};
\ No newline at end of file
+    std::mutex mutex_;                       // guards logFile_ and the drain buffers
+    std::atomic<bool> fileOpen_{false};
+    std::atomic<Ring*> rings_{nullptr};
+    std::atomic<std::time_t> coarseSeconds_{0};
+
+    std::mutex drainMutex_;
+    std::condition_variable drainCondition_;
+    std::condition_variable doneCondition_;
+    std::atomic<bool> wakeRequested_{false};
+    bool running_ = true;
+    uint64_t drainPasses_ = 0;
+    std::thread drainThread_;
+
+    std::string batch_;
+    std::string formatted_;
+    std::time_t formattedSeconds_ = 0;
+};
@@ -0,0 +1,231 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "ERROR_Handler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of an input file. Lines are handed out as
+// std::string_view slices into the mapping, so the map phase runs over the
+// page cache instead of copying every line into a std::vector<std::string>.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename) {
+        open(filename);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        swap(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    bool open(const std::string& filename) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            ErrorHandler::reportError("Could not open file " + filename + " for mapping.");
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) {
+            ErrorHandler::reportError("Could not stat file " + filename + ".");
+            close();
+            return false;
+        }
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+        if (size_ > 0) {
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mappingHandle == nullptr) {
+                ErrorHandler::reportError("Could not map file " + filename + ".");
+                close();
+                return false;
+            }
+            data_ = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            ErrorHandler::reportError("Could not open file " + filename + " for mapping.");
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ErrorHandler::reportError("Could not stat file " + filename + ".");
+            close();
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ErrorHandler::reportError("Could not map file " + filename + ".");
+                close();
+                return false;
+            }
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(addr);
+        }
+#endif
+        if (size_ > 0 && data_ == nullptr) {
+            ErrorHandler::reportError("Could not map file " + filename + ".");
+            close();
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        opened = false;
+    }
+
+    bool is_open() const { return opened; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    // Splits the mapping into consecutive regions of roughly chunkBytes each.
+    // Every region ends just after a '\n' (or at end of file), so no line is
+    // ever split between two map tasks.
+    std::vector<std::string_view> split_on_lines(size_t chunkBytes) const {
+        return split_on_lines(view(), chunkBytes);
+    }
+
+    static std::vector<std::string_view> split_on_lines(std::string_view region, size_t chunkBytes) {
+        std::vector<std::string_view> chunks;
+        while (!region.empty()) {
+            std::string_view chunk = next_chunk(region, chunkBytes);
+            chunks.push_back(chunk);
+            region.remove_prefix(chunk.size());
+        }
+        return chunks;
+    }
+
+    // The first line-aligned chunk of region, for callers that cut chunks
+    // one at a time.
+    static std::string_view next_chunk(std::string_view region, size_t chunkBytes) {
+        if (chunkBytes == 0) {
+            chunkBytes = 1;
+        }
+        if (chunkBytes >= region.size()) {
+            return region;
+        }
+        size_t newline = region.find('\n', chunkBytes - 1);
+        return newline == std::string_view::npos ? region : region.substr(0, newline + 1);
+    }
+
+    // The lines of region owned by the byte range [offset, offset + length):
+    // every line that starts inside the range, including one that runs past
+    // its end. Adjacent ranges therefore partition the lines of region.
+    static std::string_view line_range(std::string_view region, size_t offset, size_t length) {
+        if (offset >= region.size()) {
+            return std::string_view();
+        }
+        size_t begin = 0;
+        if (offset > 0) {
+            // A line starts at offset only if the byte before it is '\n'
+            size_t newline = region.find('\n', offset - 1);
+            if (newline == std::string_view::npos) {
+                return std::string_view();
+            }
+            begin = newline + 1;
+        }
+        size_t limit = length < region.size() - offset ? offset + length : region.size();
+        if (begin >= limit) {
+            return std::string_view();
+        }
+        size_t newline = region.find('\n', limit - 1);
+        size_t end = newline == std::string_view::npos ? region.size() : newline + 1;
+        return region.substr(begin, end - begin);
+    }
+
+    // Calls fn(std::string_view line) for every line in region, with the
+    // trailing "\n" or "\r\n" stripped, matching std::getline on text files.
+    template <typename Fn>
+    static void for_each_line(std::string_view region, Fn&& fn) {
+        size_t begin = 0;
+        while (begin < region.size()) {
+            size_t newline = region.find('\n', begin);
+            size_t end = (newline == std::string_view::npos) ? region.size() : newline;
+            std::string_view line = region.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            fn(line);
+            begin = end + 1;
+        }
+    }
+
+private:
+    void swap(MappedFile& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(opened, other.opened);
+#ifdef _WIN32
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+#else
+        std::swap(fd, other.fd);
+#endif
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
@@ -1,145 +1,257 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
 #include <sstream>
 #include <fstream>
 #include <mutex>
 #include <thread>
 #include <iostream>
+#include <memory>
+#include <atomic>
 #include <cstdlib>
-#include <queue>
-#include <condition_variable>
-#include <functional>
 #include "ERROR_Handler.h"
 #include "FileHandler.h"
+#include "Combiner.h"
+#include "InputSplit.h"
+#include "KernelLibrary.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "PartitionedSpill.h"
+#include "TaskArena.h"
+#include "TaskChunking.h"
 #include "Mapper_DLL_so.h"
-#include "Mapper.h"
-#include "Reducer.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
 
-class ThreadPool {
+class Mapper {
 public:
-    ThreadPool(size_t minThreads, size_t maxThreads)
-        : minThreads(minThreads), maxThreads(maxThreads), stopFlag(false) {
-        for (size_t i = 0; i < minThreads; ++i) {
-            addThread();
-        }
+    // Each map task aggregates into a Combiner of at most combinerEntries
+    // distinct words and spills whenever it fills, so task memory stays
+    // bounded however large the vocabulary is.
+    explicit Mapper(ThreadPool& pool = ThreadPool::getInstance(),
+                    size_t combinerEntries = Combiner::kDefaultEntries)
+        : threadPool(pool), combinerEntries(combinerEntries) {}
+
+    // Routes map_splits through a runtime-loaded kernel instead of the
+    // built-in tokenizer; nullptr restores the built-in.
+    void set_kernel(const mr_kernel* kernel) {
+        this->kernel = kernel;
     }
 
-    ~ThreadPool() {
-        shutdown();
+    // Single-file form kept for callers that want one mapped_temp.txt.
+    void map_words(const std::vector<std::string>& lines, const std::string& outputPath) {
+        PartitionedSpill spill({outputPath});
+        map_words(lines, spill);
     }
 
-    void enqueueTask(const std::function<void()>& task) {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            taskQueue.push(task);
-        }
-        condition.notify_one();
-        adjustThreadPool();
+    void map_words(const MappedFile& input, const std::string& outputPath) {
+        PartitionedSpill spill({outputPath});
+        map_words(input, spill);
     }
 
-    void shutdown() {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            stopFlag = true;
+    void map_words(const std::vector<std::string>& lines, PartitionedSpill& spill) {
+        if (!spill.open()) {
+            return;
         }
-        condition.notify_all();
-        for (std::thread& thread : threads) {
-            if (thread.joinable()) {
-                thread.join();
-            }
+
+        // Chunks hold about the same number of bytes, however uneven the
+        // line lengths are
+        uint64_t totalBytes = 0;
+        for (const std::string& line : lines) {
+            totalBytes += line.size() + 1;
         }
-    }
+        uint64_t chunkBytes = TaskChunking::target_bytes(totalBytes, threadPool.size(), kMinChunkBytes);
+        auto chunks = TaskChunking::ranges(lines.size(), chunkBytes, [&lines](size_t i) { return lines[i].size() + 1; });
 
-private:
-    void addThread() {
-        threads.emplace_back([this]() {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queueMutex);
-                    condition.wait(lock, [this]() {
-                        return stopFlag || !taskQueue.empty();
-                    });
-                    if (stopFlag && taskQueue.empty()) {
-                        return;
-                    }
-                    task = std::move(taskQueue.front());
-                    taskQueue.pop();
+        for (const auto& chunk : chunks) {
+            threadPool.enqueueTask([this, &lines, &spill, chunk]() {
+                TaskArena arena;
+                Combiner combiner([&spill](const Combiner& partial) { spill.spill(partial); }, combinerEntries,
+                                  arena.resource());
+                std::pmr::string scratch(arena.resource());
+
+                for (size_t j = chunk.first; j < chunk.second; ++j) {
+                    count_words(lines[j], combiner, scratch);
                 }
-                task();
-            }
-        });
-    }
 
-    void adjustThreadPool() {
-        if (taskQueue.size() > threads.size() && threads.size() < maxThreads) {
-            addThread();
+                combiner.flush();
+            });
         }
+
+        threadPool.wait();
+        spill.close();
     }
 
-    std::vector<std::thread> threads;
-    std::queue<std::function<void()>> taskQueue;
-    std::mutex queueMutex;
-    std::condition_variable condition;
-    bool stopFlag;
-    size_t minThreads;
-    size_t maxThreads;
-};
+    // Zero-copy variant: maps a memory-mapped tempInput.txt directly. Each
+    // task gets a line-aligned byte range of the mapping and tokenizes the
+    // <"filename", "line"> records in place, so no per-line std::string is
+    // ever built for the input. Counts are hash-partitioned into the spill
+    // files, one per reducer.
+    void map_words(const MappedFile& input, PartitionedSpill& spill) {
+        if (!spill.open()) {
+            return;
+        }
 
-class Mapper {
-public:
-    Mapper(size_t minThreads = 2, size_t maxThreads = 8)
-        : threadPool(minThreads, maxThreads) {}
+        std::vector<std::string_view> chunks =
+            input.split_on_lines(TaskChunking::target_bytes(input.size(), threadPool.size(), kMinChunkBytes));
 
-    void map_words(const std::vector<std::string>& lines, const std::string& outputPath) {
-        std::ofstream temp_out(outputPath);
-        if (!temp_out) {
-            ErrorHandler::reportError("Could not open " + outputPath + " for writing.");
-            return;
+        for (std::string_view chunk : chunks) {
+            threadPool.enqueueTask([this, &spill, chunk]() {
+                TaskArena arena;
+                Combiner combiner([&spill](const Combiner& partial) { spill.spill(partial); }, combinerEntries,
+                                  arena.resource());
+                std::pmr::string scratch(arena.resource());
+                map_chunk(chunk, combiner, scratch);
+                combiner.flush();
+            });
         }
 
-        std::mutex mutex;
-        size_t chunkSize = calculate_dynamic_chunk_size(lines.size());
-
-        for (size_t i = 0; i < lines.size(); i += chunkSize) {
-            threadPool.enqueueTask([this, &lines, &temp_out, &mutex, i, chunkSize]() {
-                size_t startIdx = i;
-                size_t endIdx = std::min(startIdx + chunkSize, lines.size());
-                std::map<std::string, int> localMap;
-
-                for (size_t j = startIdx; j < endIdx; ++j) {
-                    std::istringstream ss(lines[j]);
-                    std::string word;
-                    while (ss >> word) {
-                        localMap[MapperDLLso::clean_word(word)]++;
-                    }
-                }
+        threadPool.wait();
+        spill.close();
+    }
+
+    // Per-file ingestion: one task per input split. Each task maps its own
+    // file and tokenizes only the lines its byte range owns, so reading is
+    // spread over the pool instead of going through one serial reader. A
+    // task that still has a large range left when a worker goes idle gives
+    // the back half of it away as a new task (see map_range). Returns false
+    // if the spill cannot be written or any split fails to map.
+    bool map_splits(const std::vector<InputSplit>& splits, PartitionedSpill& spill) {
+        if (!spill.open()) {
+            return false;
+        }
 
-                std::lock_guard<std::mutex> lock(mutex);
-                for (const auto& kv : localMap) {
-                    temp_out << kv.first << ": " << kv.second << "\n";
+        std::atomic<uint64_t> nextTask{splits.size()};
+        std::atomic<bool> piecesOk{true};
+        std::vector<char> succeeded(splits.size(), 0);
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([this, &spill, &nextTask, &piecesOk, &succeeded, &split = splits[t], t]() {
+                auto file = std::make_shared<MappedFile>();
+                if (!file->open(split.path)) {
+                    return;
+                }
+                std::string_view text = MappedFile::line_range(file->view(), split.offset, split.length);
+                if (map_range(file, text, spill, nextTask, piecesOk, t)) {
+                    succeeded[t] = 1;
                 }
             });
         }
 
-        threadPool.shutdown();
-        temp_out.close();
+        threadPool.wait();
+        bool ok = spill.close() && piecesOk.load();
+        for (char done : succeeded) {
+            ok = ok && done;
+        }
+        return ok;
+    }
+
+    // Counts the words of raw input text. Line breaks are whitespace to the
+    // tokenizer, so text is tokenized a line-aligned slice at a time; the
+    // slices only bound the size of scratch.
+    template <typename Scratch>
+    static void map_text(std::string_view text, Combiner& combiner, Scratch& scratch) {
+        constexpr size_t kSliceBytes = 1 << 20;
+        uint64_t words = 0;
+        while (!text.empty()) {
+            std::string_view slice = MappedFile::next_chunk(text, kSliceBytes);
+            words += count_words(slice, combiner, scratch);
+            text.remove_prefix(slice.size());
+        }
+        Metrics::add(Metrics::RecordsIn, words);
+    }
+
+    // Hands text to the kernel in the same line-aligned slices map_text
+    // uses, so each call is one batch.
+    static bool map_kernel(const mr_kernel& kernel, std::string_view text, Combiner& combiner) {
+        constexpr size_t kSliceBytes = 1 << 20;
+        bool ok = true;
+        while (!text.empty()) {
+            std::string_view slice = MappedFile::next_chunk(text, kSliceBytes);
+            if (!KernelLibrary::map_text(kernel, slice, combiner)) {
+                ErrorHandler::reportError(std::string("Kernel ") + kernel.name + " failed to map a batch.");
+                ok = false;
+            }
+            text.remove_prefix(slice.size());
+        }
+        return ok;
+    }
+
+    // Counts the words of one line-aligned range of tempInput.txt records
+    // into combiner. Shared by map tasks and the pipelined mapper stage.
+    template <typename Scratch>
+    static void map_chunk(std::string_view chunk, Combiner& combiner, Scratch& scratch) {
+        MappedFile::for_each_line(chunk, [&combiner, &scratch](std::string_view kv_line) {
+            std::string_view value;
+            if (FileHandler::extract_value(kv_line, value)) {
+                count_words(value, combiner, scratch);
+            }
+        });
     }
 
 private:
-    size_t calculate_dynamic_chunk_size(size_t totalSize) {
-        size_t numThreads = std::thread::hardware_concurrency();
-        size_t defaultChunkSize = 1024;
+    static constexpr uint64_t kMinChunkBytes = 64 * 1024;
+    static constexpr size_t kRangeSliceBytes = 1 << 20;
+
+    // Maps text, a line-aligned range of file, one slice at a time. Between
+    // slices it checks whether the pool has an idle worker and nothing
+    // queued; if so, and enough is left, the back half of the remainder
+    // becomes a new task on this worker's deque, where the idle worker
+    // steals it. Each piece keeps the mapping alive through file. Returns
+    // false if the kernel failed on this range; pieces given away clear
+    // piecesOk instead.
+    bool map_range(std::shared_ptr<MappedFile> file, std::string_view text, PartitionedSpill& spill,
+                   std::atomic<uint64_t>& nextTask, std::atomic<bool>& piecesOk, uint64_t taskId) {
+        Metrics::TaskScope task("map", taskId);
+        Metrics::gauge("pool_queue", threadPool.queuedTaskCount());
+        TaskArena arena;
+        Combiner combiner([&spill](const Combiner& partial) { spill.spill(partial); }, combinerEntries,
+                          arena.resource());
+        std::pmr::string scratch(arena.resource());
+        bool ok = true;
+        while (!text.empty()) {
+            std::string_view slice = MappedFile::next_chunk(text, kRangeSliceBytes);
+            if (kernel != nullptr) {
+                ok = map_kernel(*kernel, slice, combiner) && ok;
+            } else {
+                map_text(slice, combiner, scratch);
+            }
+            Metrics::add(Metrics::BytesRead, slice.size());
+            text.remove_prefix(slice.size());
 
-        if (numThreads == 0) {
-            return defaultChunkSize;
+            if (TaskChunking::should_split(threadPool, text.size(), InputSplit::kMinSplitBytes)) {
+                std::string_view keep = MappedFile::next_chunk(text, text.size() / 2);
+                std::string_view rest = text.substr(keep.size());
+                if (!rest.empty()) {
+                    text = keep;
+                    uint64_t restId = nextTask.fetch_add(1, std::memory_order_relaxed);
+                    threadPool.enqueueTask([this, file, rest, &spill, &nextTask, &piecesOk, restId]() {
+                        if (!map_range(file, rest, spill, nextTask, piecesOk, restId)) {
+                            piecesOk = false;
+                        }
+                    });
+                }
+            }
         }
+        combiner.flush();
+        return ok;
+    }
 
-        size_t chunkSize = totalSize / numThreads;
-        return chunkSize > defaultChunkSize ? chunkSize : defaultChunkSize;
+    // Same words as istringstream >> word + clean_word, via the block
+    // tokenizer; scratch is reused across lines of one task. Returns the
+    // number of words.
+    template <typename Scratch>
+    static uint64_t count_words(std::string_view line, Combiner& combiner, Scratch& scratch) {
+        uint64_t words = 0;
+        Tokenizer::for_each_word(line, scratch, [&combiner, &words](std::string_view word) {
+            combiner.add(word);
+            ++words;
+        });
+        return words;
     }
 
-    ThreadPool threadPool;
+    ThreadPool& threadPool;
+    size_t combinerEntries;
+    const mr_kernel* kernel = nullptr;
 };
\ No newline at end of file
@@ -2,12 +2,16 @@
 #define MAPPER_DLL_SO_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 #include <fstream>
 #include <sstream>
 #include <cctype>
 #include <iostream>
+#include "Combiner.h"
+#include "RecordIO.h"
+#include "Tokenizer.h"
 
 // Export macro for cross-platform compatibility
 #if defined(_WIN32) || defined(_WIN64)
@@ -20,53 +24,51 @@
 
 class DLL_so_EXPORT MapperDLLso {
 public:
+    // combinerEntries > 0 sums counts in a bounded map-side combiner of that
+    // many distinct words before they are written; 0 writes one <word, 1>
+    // record per token.
+    explicit MapperDLLso(size_t combinerEntries = Combiner::kDefaultEntries)
+        : combinerEntries(combinerEntries) {}
+
     static bool is_valid_char(char c) {
         return std::isalnum(static_cast<unsigned char>(c));
     }
 
-    static std::string clean_word(const std::string &word) {
-        std::string result;
-        for (char c : word) {
-            if (is_valid_char(c)) {
-                result += std::tolower(static_cast<unsigned char>(c));
-            }
-        }
+    static std::string clean_word(std::string_view word) {
+        std::string result(word.size(), '\0');
+        result.resize(Tokenizer::clean_into(word, &result[0]));
         return result;
     }
 
     void map_words(const std::vector<std::string> &lines, const std::string &tempFolderPath) {
         // Ensure cross-platform path handling
         #ifdef _WIN32
-        std::string outputPath = tempFolderPath + "\\mapped_temp.txt";
+        std::string outputPath = tempFolderPath + "\\mapped_temp.bin";
         #else
-        std::string outputPath = tempFolderPath + "/mapped_temp.txt";
+        std::string outputPath = tempFolderPath + "/mapped_temp.bin";
         #endif
 
-        std::ofstream temp_out(outputPath);
-        if (!temp_out) {
+        RecordWriter temp_out;
+        if (!temp_out.open(outputPath)) {
             std::cerr << "Failed to open " << outputPath << " for writing." << std::endl;
             return;
         }
 
         std::cout << "Mapping words..." << std::endl;
-        for (const auto &line : lines) {
-            std::stringstream ss(line);
-            std::string word;
-            while (ss >> word) {
-                std::string cleaned = clean_word(word);
-                if (!cleaned.empty()) {
-                    mapped.push_back({cleaned, 1});
-                    if (mapped.size() >= 100) {
-                        write_chunk_to_file(temp_out);
-                        mapped.clear();
-                    }
+        if (combinerEntries > 0) {
+            Combiner combiner([&temp_out](const Combiner &partial) {
+                for (const auto &kv : partial) {
+                    temp_out.write(kv.first, kv.second);
                 }
-            }
-        }
-
-        if (!mapped.empty()) {
-            write_chunk_to_file(temp_out);
-            mapped.clear();
+            }, combinerEntries);
+            for_each_word(lines, [&combiner](std::string_view cleaned) {
+                combiner.add(cleaned);
+            });
+            combiner.flush();
+        } else {
+            for_each_word(lines, [&temp_out](std::string_view cleaned) {
+                temp_out.write(cleaned, 1);
+            });
         }
 
         temp_out.close();
@@ -74,11 +76,13 @@ public:
     }
 
 private:
-    std::vector<std::pair<std::string, int>> mapped;
+    size_t combinerEntries;
 
-    void write_chunk_to_file(std::ofstream &outfile) {
-        for (const auto &kv : mapped) {
-            outfile << "<" << kv.first << ", " << kv.second << ">" << std::endl;
+    template <typename Fn>
+    static void for_each_word(const std::vector<std::string> &lines, Fn &&fn) {
+        std::string scratch;
+        for (const auto &line : lines) {
+            Tokenizer::for_each_word(line, scratch, fn);
         }
     }
 };
@@ -0,0 +1,410 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "ERROR_Handler.h"
+
+// Structured counters and timers for a job run. Off by default; when it is
+// off every call is one relaxed load.
+//
+// Work is measured per task: a TaskScope on the stack of a pool task (or a
+// pipeline stage, or the driver) times the task, and add() charges counters
+// to whatever task the calling thread is running. gauge() samples a queue
+// depth. Everything lands in a slot owned by the calling thread, so nothing
+// is shared or locked while the job runs; slots are only read when the
+// report is written, after the job's tasks have finished.
+//
+// write_json() summarizes each phase (task count, wall and busy time,
+// latency percentiles, a log2 duration histogram and the counter totals);
+// write_trace() exports every task and gauge sample in Chrome trace-event
+// format for chrome://tracing or Perfetto.
+class Metrics {
+    struct Slot;
+
+public:
+    enum Counter : size_t {
+        BytesRead,
+        RecordsIn,
+        RecordsOut,
+        Spills,
+        LockWaitNanos,
+        QueueWaitNanos,
+        kCounterCount
+    };
+
+    static constexpr size_t kHistogramBuckets = 32;   // bucket b: duration < 2^b us
+
+    struct PhaseSummary {
+        std::string name;
+        size_t tasks = 0;
+        uint64_t wallNanos = 0;       // first task start to last task end
+        uint64_t busyNanos = 0;       // sum of task durations
+        uint64_t p50Nanos = 0;
+        uint64_t p99Nanos = 0;
+        uint64_t maxNanos = 0;
+        uint64_t counters[kCounterCount] = {};
+        uint64_t histogram[kHistogramBuckets] = {};
+    };
+
+    struct GaugeSummary {
+        std::string name;
+        size_t samples = 0;
+        uint64_t max = 0;
+        double mean = 0.0;
+    };
+
+    static Metrics& getInstance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    static const char* counter_name(Counter counter) {
+        static const char* const names[kCounterCount] = {
+            "bytes_read", "records_in", "records_out", "spills", "lock_wait_ns", "queue_wait_ns"};
+        return names[counter];
+    }
+
+    // Turning collection on restarts the report clock.
+    void set_enabled(bool on) {
+        if (on) {
+            epoch = std::chrono::steady_clock::now();
+        }
+        enabledFlag.store(on, std::memory_order_release);
+    }
+
+    bool enabled() const {
+        return enabledFlag.load(std::memory_order_relaxed);
+    }
+
+    // Nanoseconds since collection was enabled.
+    uint64_t now() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    // Charges value to the calling thread's current task. Outside any task
+    // it goes to the "unscoped" phase.
+    static void add(Counter counter, uint64_t value) {
+        Metrics& metrics = getInstance();
+        if (!metrics.enabled()) {
+            return;
+        }
+        Slot& slot = metrics.threadSlot();
+        (slot.inTask ? slot.current : slot.unscoped)[counter] += value;
+    }
+
+    // Records one sample of a named level, e.g. a queue depth. name must be
+    // a string literal (only the pointer is kept).
+    static void gauge(const char* name, uint64_t value) {
+        Metrics& metrics = getInstance();
+        if (!metrics.enabled()) {
+            return;
+        }
+        metrics.threadSlot().gauges.push_back(GaugeSample{name, metrics.now(), value});
+    }
+
+    // Times one task of phase (a string literal) from construction to
+    // destruction and keeps the counters added meanwhile. A scope opened
+    // inside another task on the same thread is folded into the outer one.
+    class TaskScope {
+    public:
+        TaskScope(const char* phase, uint64_t index) {
+            Metrics& metrics = getInstance();
+            if (!metrics.enabled()) {
+                return;
+            }
+            Slot& owner = metrics.threadSlot();
+            if (owner.inTask) {
+                return;
+            }
+            slot = &owner;
+            slot->inTask = true;
+            std::fill(std::begin(slot->current), std::end(slot->current), 0);
+            this->phase = phase;
+            this->index = index;
+            startNanos = metrics.now();
+        }
+
+        ~TaskScope() {
+            if (slot == nullptr) {
+                return;
+            }
+            TaskEvent event;
+            event.phase = phase;
+            event.index = index;
+            event.startNanos = startNanos;
+            event.durationNanos = getInstance().now() - startNanos;
+            std::copy(std::begin(slot->current), std::end(slot->current), std::begin(event.counters));
+            slot->tasks.push_back(event);
+            slot->inTask = false;
+        }
+
+        TaskScope(const TaskScope&) = delete;
+        TaskScope& operator=(const TaskScope&) = delete;
+
+    private:
+        Slot* slot = nullptr;
+        const char* phase = "";
+        uint64_t index = 0;
+        uint64_t startNanos = 0;
+    };
+
+    // Drops everything collected so far. Only call while no task is running.
+    void reset() {
+        for (Slot* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            slot->tasks.clear();
+            slot->gauges.clear();
+            std::fill(std::begin(slot->unscoped), std::end(slot->unscoped), 0);
+        }
+        epoch = std::chrono::steady_clock::now();
+    }
+
+    // Phases in the order their first task started.
+    std::vector<PhaseSummary> phases() const {
+        std::map<std::string, std::vector<const TaskEvent*>> byPhase;
+        uint64_t unscoped[kCounterCount] = {};
+        bool anyUnscoped = false;
+        for (Slot* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            for (const TaskEvent& event : slot->tasks) {
+                byPhase[event.phase].push_back(&event);
+            }
+            for (size_t c = 0; c < kCounterCount; ++c) {
+                unscoped[c] += slot->unscoped[c];
+                anyUnscoped = anyUnscoped || slot->unscoped[c] != 0;
+            }
+        }
+
+        std::vector<std::pair<uint64_t, PhaseSummary>> ordered;
+        for (auto& entry : byPhase) {
+            std::vector<const TaskEvent*>& events = entry.second;
+            PhaseSummary summary;
+            summary.name = entry.first;
+            summary.tasks = events.size();
+            uint64_t first = UINT64_MAX;
+            uint64_t last = 0;
+            std::vector<uint64_t> durations;
+            for (const TaskEvent* event : events) {
+                first = std::min(first, event->startNanos);
+                last = std::max(last, event->startNanos + event->durationNanos);
+                summary.busyNanos += event->durationNanos;
+                durations.push_back(event->durationNanos);
+                ++summary.histogram[histogram_bucket(event->durationNanos)];
+                for (size_t c = 0; c < kCounterCount; ++c) {
+                    summary.counters[c] += event->counters[c];
+                }
+            }
+            std::sort(durations.begin(), durations.end());
+            summary.wallNanos = last - first;
+            summary.p50Nanos = percentile(durations, 50);
+            summary.p99Nanos = percentile(durations, 99);
+            summary.maxNanos = durations.back();
+            ordered.emplace_back(first, std::move(summary));
+        }
+        std::stable_sort(ordered.begin(), ordered.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::vector<PhaseSummary> result;
+        for (auto& entry : ordered) {
+            result.push_back(std::move(entry.second));
+        }
+        if (anyUnscoped) {
+            PhaseSummary summary;
+            summary.name = "unscoped";
+            std::copy(std::begin(unscoped), std::end(unscoped), std::begin(summary.counters));
+            result.push_back(summary);
+        }
+        return result;
+    }
+
+    std::vector<GaugeSummary> gauges() const {
+        std::map<std::string, GaugeSummary> byName;
+        std::map<std::string, double> sums;
+        for (Slot* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            for (const GaugeSample& sample : slot->gauges) {
+                GaugeSummary& summary = byName[sample.name];
+                summary.name = sample.name;
+                ++summary.samples;
+                summary.max = std::max(summary.max, sample.value);
+                sums[sample.name] += static_cast<double>(sample.value);
+            }
+        }
+        std::vector<GaugeSummary> result;
+        for (auto& entry : byName) {
+            entry.second.mean = sums[entry.first] / static_cast<double>(entry.second.samples);
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    bool write_json(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            ErrorHandler::reportError("Could not open " + path + " for writing.");
+            return false;
+        }
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"elapsed_ms\": " << now() / 1e6 << ",\n  \"phases\": [";
+        std::vector<PhaseSummary> summaries = phases();
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            const PhaseSummary& phase = summaries[i];
+            out << (i > 0 ? "," : "") << "\n    {\"name\": \"" << phase.name << "\", \"tasks\": " << phase.tasks
+                << ", \"wall_ms\": " << phase.wallNanos / 1e6 << ", \"busy_ms\": " << phase.busyNanos / 1e6
+                << ", \"task_p50_ms\": " << phase.p50Nanos / 1e6 << ", \"task_p99_ms\": " << phase.p99Nanos / 1e6
+                << ", \"task_max_ms\": " << phase.maxNanos / 1e6;
+            for (size_t c = 0; c < kCounterCount; ++c) {
+                out << ", \"" << counter_name(static_cast<Counter>(c)) << "\": " << phase.counters[c];
+            }
+            out << ", \"task_histogram\": [";
+            bool first = true;
+            for (size_t b = 0; b < kHistogramBuckets; ++b) {
+                if (phase.histogram[b] != 0) {
+                    out << (first ? "" : ", ") << "{\"lt_us\": " << (uint64_t(1) << b)
+                        << ", \"count\": " << phase.histogram[b] << "}";
+                    first = false;
+                }
+            }
+            out << "]}";
+        }
+        out << "\n  ],\n  \"gauges\": [";
+        std::vector<GaugeSummary> levels = gauges();
+        for (size_t i = 0; i < levels.size(); ++i) {
+            out << (i > 0 ? "," : "") << "\n    {\"name\": \"" << levels[i].name << "\", \"samples\": "
+                << levels[i].samples << ", \"max\": " << levels[i].max << ", \"mean\": " << levels[i].mean << "}";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+    // Chrome trace-event JSON: one complete ("X") event per task on its
+    // thread's track, one counter ("C") event per gauge sample.
+    bool write_trace(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            ErrorHandler::reportError("Could not open " + path + " for writing.");
+            return false;
+        }
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        bool first = true;
+        auto separator = [&out, &first]() {
+            out << (first ? "\n" : ",\n");
+            first = false;
+        };
+        for (Slot* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            separator();
+            out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << slot->id
+                << ", \"args\": {\"name\": \"thread " << slot->id << "\"}}";
+            for (const TaskEvent& event : slot->tasks) {
+                separator();
+                out << "{\"name\": \"" << event.phase << " " << event.index << "\", \"cat\": \"" << event.phase
+                    << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << slot->id << ", \"ts\": " << event.startNanos / 1e3
+                    << ", \"dur\": " << event.durationNanos / 1e3 << ", \"args\": {";
+                for (size_t c = 0; c < kCounterCount; ++c) {
+                    out << (c > 0 ? ", " : "") << "\"" << counter_name(static_cast<Counter>(c)) << "\": "
+                        << event.counters[c];
+                }
+                out << "}}";
+            }
+            for (const GaugeSample& sample : slot->gauges) {
+                separator();
+                out << "{\"name\": \"" << sample.name << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": "
+                    << sample.atNanos / 1e3 << ", \"args\": {\"depth\": " << sample.value << "}}";
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    struct TaskEvent {
+        const char* phase = "";
+        uint64_t index = 0;
+        uint64_t startNanos = 0;
+        uint64_t durationNanos = 0;
+        uint64_t counters[kCounterCount] = {};
+    };
+
+    struct GaugeSample {
+        const char* name;
+        uint64_t atNanos;
+        uint64_t value;
+    };
+
+    // Written only by the owning thread. Slots are reused by later threads
+    // once their owner exits, like Logger's rings.
+    struct Slot {
+        std::atomic<bool> owned{true};
+        size_t id = 0;
+        Slot* next = nullptr;
+        bool inTask = false;
+        uint64_t current[kCounterCount] = {};
+        uint64_t unscoped[kCounterCount] = {};
+        std::vector<TaskEvent> tasks;
+        std::vector<GaugeSample> gauges;
+    };
+
+    struct ThreadSlot {
+        Slot* slot = nullptr;
+        ~ThreadSlot() {
+            if (slot != nullptr) {
+                slot->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    Metrics() = default;
+
+    // Slots are never freed: pool threads of other singletons may outlive
+    // this object and still release their slot on exit.
+    ~Metrics() = default;
+
+    Slot& threadSlot() {
+        thread_local ThreadSlot local;
+        if (local.slot == nullptr) {
+            local.slot = claimSlot();
+        }
+        return *local.slot;
+    }
+
+    Slot* claimSlot() {
+        for (Slot* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            bool expected = false;
+            if (slot->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+        Slot* slot = new Slot();
+        slot->id = nextSlotId.fetch_add(1, std::memory_order_relaxed);
+        slot->next = slots.load(std::memory_order_relaxed);
+        while (!slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return slot;
+    }
+
+    static size_t histogram_bucket(uint64_t nanos) {
+        uint64_t micros = nanos / 1000;
+        size_t bucket = 0;
+        while (bucket + 1 < kHistogramBuckets && (uint64_t(1) << bucket) <= micros) {
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // Nearest rank over sorted values.
+    static uint64_t percentile(const std::vector<uint64_t>& sorted, size_t p) {
+        size_t rank = (sorted.size() * p + 99) / 100;
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    std::atomic<bool> enabledFlag{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::atomic<Slot*> slots{nullptr};
+    std::atomic<size_t> nextSlotId{0};
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+#include "BlockCodec.h"
+#include "ERROR_Handler.h"
+#include "Hash.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "SpaceSaving.h"
+
+// Map-side half of the shuffle. Every key is assigned to one of R partitions
+// by a stable hash and written to that partition's spill file, so reducer r
+// only ever has to read spill file r. Each partition has its own lock; a map
+// task buckets its whole chunk first and then takes each partition lock once
+// to append one block, so mappers rarely contend with each other. Spill
+// files use the binary record format from RecordIO.h, block-compressed when
+// the job's codec asks for it (each bucket becomes one frame, compressed
+// before the lock is taken).
+//
+// With hot-key splitting on, every spill also feeds a sample of its records
+// into a shared Space-Saving summary. A key whose sampled share of records
+// would make its home partition half again as large as the average is hot:
+// from then on its records are dealt round-robin over hot_key_fanout()
+// partitions instead of all landing on one reducer. Only use it when the
+// reduce is a sum: the reducers then each hold a partial count for a hot
+// key and the final merge of their tables (FlatStringMap::merge, or the
+// external k-way merge) adds them up.
+class PartitionedSpill {
+public:
+    explicit PartitionedSpill(const std::vector<std::string>& paths,
+                              BlockCodec::Codec codec = RecordWriter::default_codec())
+        : codec(codec) {
+        for (const std::string& path : paths) {
+            auto partition = std::make_unique<Partition>();
+            partition->path = path;
+            partitions.push_back(std::move(partition));
+        }
+    }
+
+    // <basePath>_0.bin ... <basePath>_<R-1>.bin
+    static std::vector<std::string> spill_paths(const std::string& basePath, size_t numPartitions) {
+        std::vector<std::string> paths;
+        for (size_t p = 0; p < numPartitions; ++p) {
+            paths.push_back(basePath + "_" + std::to_string(p) + ".bin");
+        }
+        return paths;
+    }
+
+    // Stable across runs and processes (see Hash.h), which keeps spill
+    // files reusable between runs.
+    static uint64_t hash_key(std::string_view key) {
+        return Hash::fnv1a(key);
+    }
+
+    static size_t partition_for(std::string_view key, size_t numPartitions) {
+        return static_cast<size_t>(hash_key(key) % numPartitions);
+    }
+
+    // Truncates every spill file.
+    bool open() {
+        rawBytes.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(sampleMutex);
+            sample = SpaceSaving(sample.get_capacity());
+            sampledRecords = 0;
+            std::atomic_store(&hotKeys, std::shared_ptr<const HotKeys>());
+        }
+        for (auto& partition : partitions) {
+            partition->out.open(partition->path, std::ios::binary | std::ios::trunc);
+            if (!partition->out) {
+                ErrorHandler::reportError("Could not open " + partition->path + " for writing.");
+                return false;
+            }
+            if (codec != BlockCodec::Codec::None) {
+                partition->out.write(BlockCodec::kMagic, BlockCodec::kMagicBytes);
+            }
+        }
+        return true;
+    }
+
+    // Returns false if any spill file failed to write.
+    bool close() {
+        bool ok = true;
+        for (auto& partition : partitions) {
+            if (partition->out.is_open()) {
+                partition->out.close();
+                ok = ok && !partition->out.fail();
+            }
+        }
+        return ok;
+    }
+
+    // fanout = partitions a hot key is spread over; 0 = all of them.
+    void enable_hot_key_splitting(size_t fanout = 0) {
+        hotFanout = fanout == 0 || fanout > partitions.size() ? partitions.size() : fanout;
+        hotSplitting = hotFanout > 1;
+    }
+
+    size_t hot_key_fanout() const {
+        return hotSplitting ? hotFanout : 1;
+    }
+
+    // Keys currently being spread over several partitions.
+    std::vector<std::string> hot_keys() const {
+        std::vector<std::string> keys;
+        if (std::shared_ptr<const HotKeys> hot = std::atomic_load(&hotKeys)) {
+            for (const auto& kv : *hot) {
+                keys.emplace_back(kv.first);
+            }
+        }
+        return keys;
+    }
+
+    // Writes the chunk-local counts of one map task. Counts is any map-like
+    // container of (key, count) pairs.
+    template <typename Counts>
+    void spill(const Counts& counts) {
+        std::vector<std::string> buckets(partitions.size());
+        uint64_t records = 0;
+        std::shared_ptr<const HotKeys> hot = hotSplitting ? std::atomic_load(&hotKeys) : nullptr;
+        size_t deal = hotSplitting ? nextDeal.fetch_add(1, std::memory_order_relaxed) : 0;
+        // Counts are often in first-seen order, so the sampled positions
+        // move from call to call
+        uint64_t sampleOffset = Hash::mix(deal) % kSampleEvery;
+        FlatStringMap<uint64_t> sampled;
+        for (const auto& kv : counts) {
+            size_t p = partition_for(kv.first, partitions.size());
+            if (hot && hot->find(kv.first) != nullptr) {
+                p = (p + deal++ % hotFanout) % partitions.size();
+            }
+            RecordWriter::append_record(buckets[p], kv.first, static_cast<uint64_t>(kv.second));
+            if (hotSplitting && (records + sampleOffset) % kSampleEvery == 0) {
+                ++sampled[kv.first];
+            }
+            ++records;
+        }
+        if (!sampled.empty()) {
+            update_hot_keys(sampled);
+        }
+        Metrics::add(Metrics::RecordsOut, records);
+        Metrics::add(Metrics::Spills, 1);
+        bool timed = Metrics::getInstance().enabled();
+        std::string frame;
+        for (size_t p = 0; p < partitions.size(); ++p) {
+            if (buckets[p].empty()) {
+                continue;
+            }
+            rawBytes.fetch_add(buckets[p].size(), std::memory_order_relaxed);
+            const std::string* block = &buckets[p];
+            if (codec != BlockCodec::Codec::None) {
+                frame.clear();
+                BlockCodec::append_frame(frame, buckets[p].data(), buckets[p].size());
+                block = &frame;
+            }
+            uint64_t waitStart = timed ? Metrics::getInstance().now() : 0;
+            std::lock_guard<std::mutex> lock(partitions[p]->mutex);
+            if (timed) {
+                Metrics::add(Metrics::LockWaitNanos, Metrics::getInstance().now() - waitStart);
+            }
+            partitions[p]->out.write(block->data(), static_cast<std::streamsize>(block->size()));
+        }
+    }
+
+    // Record bytes spilled so far, before compression.
+    uint64_t raw_bytes() const {
+        return rawBytes.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return partitions.size();
+    }
+
+    const std::string& path(size_t partition) const {
+        return partitions[partition]->path;
+    }
+
+    std::vector<std::string> paths() const {
+        std::vector<std::string> result;
+        for (const auto& partition : partitions) {
+            result.push_back(partition->path);
+        }
+        return result;
+    }
+
+private:
+    using HotKeys = FlatStringMap<char>;
+
+    static constexpr uint64_t kSampleEvery = 16;
+    static constexpr uint64_t kMinSampledRecords = 4096;
+    static constexpr size_t kMaxHotKeys = 64;
+
+    // Adds one spill's sample to the summary and republishes the hot set if
+    // it changed. Runs once per spill call, under its own lock.
+    void update_hot_keys(const FlatStringMap<uint64_t>& sampled) {
+        std::lock_guard<std::mutex> lock(sampleMutex);
+        for (const auto& kv : sampled) {
+            sampledRecords += kv.second;
+        }
+        sample.add_exact(sampled);
+        if (sampledRecords < kMinSampledRecords) {
+            return;
+        }
+        // Hot: more than half an average partition's share of the records
+        uint64_t threshold = sampledRecords / (2 * partitions.size());
+        std::vector<const SpaceSaving::Counter*> heavy;
+        for (const SpaceSaving::Counter& counter : sample.get_counters()) {
+            if (counter.count - counter.error > threshold) {
+                heavy.push_back(&counter);
+            }
+        }
+        std::sort(heavy.begin(), heavy.end(), [](const auto* a, const auto* b) { return a->count > b->count; });
+        if (heavy.size() > kMaxHotKeys) {
+            heavy.resize(kMaxHotKeys);
+        }
+
+        std::shared_ptr<const HotKeys> current = std::atomic_load(&hotKeys);
+        bool changed = (current ? current->size() : 0) != heavy.size();
+        for (size_t i = 0; i < heavy.size() && !changed; ++i) {
+            changed = current->find(heavy[i]->key) == nullptr;
+        }
+        if (!changed) {
+            return;
+        }
+        auto next = std::make_shared<HotKeys>();
+        for (const SpaceSaving::Counter* counter : heavy) {
+            (*next)[counter->key] = 1;
+        }
+        std::atomic_store(&hotKeys, std::shared_ptr<const HotKeys>(std::move(next)));
+    }
+
+    struct alignas(64) Partition {
+        std::mutex mutex;
+        std::ofstream out;
+        std::string path;
+    };
+
+    std::vector<std::unique_ptr<Partition>> partitions;
+    BlockCodec::Codec codec;
+    std::atomic<uint64_t> rawBytes{0};
+
+    bool hotSplitting = false;
+    size_t hotFanout = 1;
+    std::atomic<size_t> nextDeal{0};
+    std::shared_ptr<const HotKeys> hotKeys;   // read and replaced with atomic_load / atomic_store
+    std::mutex sampleMutex;
+    SpaceSaving sample{256};
+    uint64_t sampledRecords = 0;
+};
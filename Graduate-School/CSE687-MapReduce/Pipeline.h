@@ -0,0 +1,209 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "BoundedQueue.h"
+#include "ERROR_Handler.h"
+#include "Combiner.h"
+#include "FlatStringMap.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Mapper.h"
+#include "Metrics.h"
+#include "PartitionedSpill.h"
+#include "RecordIO.h"
+
+// Pipelined execution mode: reader, mapper and reducer stages run at the
+// same time, connected by bounded queues instead of intermediate files.
+//
+//   reader --chunks--> mappers --partition batches--> reducer r (one queue each)
+//
+// The reader maps each input file in turn and cuts its splits into
+// line-aligned chunks. Each mapper combines
+// one chunk at a time, splits the partial counts by partition and pushes one
+// encoded batch per partition. Every reducer owns one partition and folds
+// batches into its table as they arrive, so reduce overlaps with map and no
+// spill file is written. Peak memory is bounded by the queue depths (plus
+// the reducer tables, which hold one entry per distinct word).
+//
+// Stages are dedicated threads rather than pool tasks: they block on their
+// queues for the whole run, which would starve a shared pool.
+class Pipeline {
+public:
+    struct Options {
+        size_t mappers = 0;           // 0 = derive from hardware_concurrency
+        size_t reducers = 0;          // 0 = derive from hardware_concurrency
+        size_t queueDepth = 64;       // slots per queue
+        size_t chunkBytes = 1 << 20;  // input bytes per map chunk
+        size_t combinerEntries = Combiner::kDefaultEntries;
+    };
+
+    Pipeline() : Pipeline(Options()) {}
+
+    explicit Pipeline(Options options)
+        : options(options) {
+        size_t hw = std::thread::hardware_concurrency();
+        hw = hw > 2 ? hw : 2;
+        if (this->options.reducers == 0) {
+            this->options.reducers = std::max<size_t>(1, hw / 4);
+        }
+        if (this->options.mappers == 0) {
+            this->options.mappers = std::max<size_t>(1, hw - this->options.reducers);
+        }
+        if (this->options.queueDepth < 2) {
+            this->options.queueDepth = 2;
+        }
+    }
+
+    // Runs the whole job over the input splits and leaves the reduced
+    // counts in result.
+    bool run(const std::vector<InputSplit>& splits, FlatStringMap<uint64_t>& result) {
+        size_t numReducers = options.reducers;
+        BoundedQueue<std::string_view> chunkQueue(options.queueDepth);
+        std::vector<std::unique_ptr<BoundedQueue<std::string>>> batchQueues;
+        for (size_t r = 0; r < numReducers; ++r) {
+            batchQueues.push_back(std::make_unique<BoundedQueue<std::string>>(options.queueDepth));
+        }
+        std::vector<FlatStringMap<uint64_t>> partitionResults(numReducers);
+        std::atomic<bool> corrupt{false};
+
+        // Reducers start first so they are ready for the first batch
+        std::vector<std::thread> reducers;
+        for (size_t r = 0; r < numReducers; ++r) {
+            reducers.emplace_back([&batchQueues, &partitionResults, &corrupt, r]() {
+                Metrics::TaskScope task("pipeline_reduce", r);
+                FlatStringMap<uint64_t>& table = partitionResults[r];
+                std::string batch;
+                uint64_t records = 0;
+                while (batchQueues[r]->pop(batch)) {
+                    const char* pos = batch.data();
+                    const char* end = pos + batch.size();
+                    std::string_view key;
+                    uint64_t count;
+                    while (pos < end) {
+                        if (!RecordReader::read_record(pos, end, key, count)) {
+                            corrupt = true;
+                            break;
+                        }
+                        table[key] += count;
+                        ++records;
+                    }
+                }
+                Metrics::add(Metrics::RecordsIn, records);
+                Metrics::add(Metrics::RecordsOut, table.size());
+            });
+        }
+
+        std::vector<std::thread> mappers;
+        std::atomic<uint64_t> chunkSequence{0};
+        for (size_t m = 0; m < options.mappers; ++m) {
+            mappers.emplace_back([this, &chunkQueue, &batchQueues, &chunkSequence, numReducers]() {
+                Combiner combiner([&batchQueues, numReducers](const Combiner& partial) {
+                    std::vector<std::string> buckets(numReducers);
+                    for (const auto& kv : partial) {
+                        RecordWriter::append_record(buckets[PartitionedSpill::partition_for(kv.first, numReducers)],
+                                                    kv.first, kv.second);
+                    }
+                    Metrics::add(Metrics::RecordsOut, partial.size());
+                    for (size_t r = 0; r < numReducers; ++r) {
+                        if (!buckets[r].empty()) {
+                            push_timed(*batchQueues[r], std::move(buckets[r]));
+                            Metrics::gauge("batch_queue", batchQueues[r]->size_approx());
+                        }
+                    }
+                }, options.combinerEntries);
+                std::string scratch;
+                std::string_view chunk;
+                while (chunkQueue.pop(chunk)) {
+                    Metrics::TaskScope task("pipeline_map", chunkSequence.fetch_add(1, std::memory_order_relaxed));
+                    Metrics::add(Metrics::BytesRead, chunk.size());
+                    Mapper::map_text(chunk, combiner, scratch);
+                    combiner.flush();
+                }
+            });
+        }
+
+        // Reader stage runs on the calling thread. It faults each chunk's
+        // pages in before handing the chunk on, so disk reads overlap with
+        // mapping instead of stalling the mappers. Mappings stay open until
+        // the mappers are done with their chunks.
+        std::vector<MappedFile> files;
+        bool readable = true;
+        std::string openPath;
+        for (const InputSplit& split : splits) {
+            if (files.empty() || split.path != openPath) {
+                files.emplace_back();
+                openPath = split.path;
+                if (!files.back().open(split.path)) {
+                    readable = false;
+                    continue;
+                }
+            }
+            if (!files.back().is_open()) {
+                continue;
+            }
+            std::string_view remaining = MappedFile::line_range(files.back().view(), split.offset, split.length);
+            while (!remaining.empty()) {
+                std::string_view chunk = MappedFile::next_chunk(remaining, options.chunkBytes);
+                touch_pages(chunk);
+                push_timed(chunkQueue, chunk);
+                Metrics::gauge("chunk_queue", chunkQueue.size_approx());
+                remaining.remove_prefix(chunk.size());
+            }
+        }
+        chunkQueue.close();
+
+        for (std::thread& mapper : mappers) {
+            mapper.join();
+        }
+        for (auto& queue : batchQueues) {
+            queue->close();
+        }
+        for (std::thread& reducer : reducers) {
+            reducer.join();
+        }
+
+        result.clear();
+        for (FlatStringMap<uint64_t>& partition : partitionResults) {
+            result.merge(std::move(partition));
+        }
+        if (!readable) {
+            return false;
+        }
+        if (corrupt) {
+            ErrorHandler::reportError("Pipeline received a malformed record batch.");
+            return false;
+        }
+        return true;
+    }
+
+    const Options& get_options() const {
+        return options;
+    }
+
+private:
+    // Pushes item, charging any time spent waiting for a free slot to the
+    // calling task's queue wait.
+    template <typename T>
+    static void push_timed(BoundedQueue<T>& queue, T item) {
+        if (queue.try_push(item)) {
+            return;
+        }
+        uint64_t waitStart = Metrics::getInstance().now();
+        queue.push(std::move(item));
+        Metrics::add(Metrics::QueueWaitNanos, Metrics::getInstance().now() - waitStart);
+    }
+
+    static void touch_pages(std::string_view region) {
+        volatile char sink = 0;
+        for (size_t offset = 0; offset < region.size(); offset += 4096) {
+            sink = sink + region[offset];
+        }
+    }
+
+    Options options;
+};
@@ -0,0 +1,376 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "BlockCodec.h"
+#include "ERROR_Handler.h"
+
+// Binary intermediate record format shared by every writer of mapped data:
+//
+//     varint(key length) | key bytes | varint(count)
+//
+// Varints are LEB128 (7 bits per byte, high bit = more bytes follow). A
+// typical word-count record is 1 + |word| + 1 bytes, there is nothing to
+// escape, and reading it back is a couple of byte loads instead of find /
+// substr / stringstream per line.
+//
+// Files may also be block-compressed (see BlockCodec.h). The writer's codec
+// is chosen per job through set_default_codec or per file in open(); the
+// reader detects it from the file header, so every reader handles both.
+class RecordWriter {
+public:
+    static constexpr size_t kMaxVarintBytes = 10;
+
+    static void append_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static void append_record(std::string& out, std::string_view key, uint64_t count) {
+        append_varint(out, key.size());
+        out.append(key.data(), key.size());
+        append_varint(out, count);
+    }
+
+    // Codec used by writers that are not given one explicitly.
+    static void set_default_codec(BlockCodec::Codec codec) {
+        default_codec_ref() = codec;
+    }
+
+    static BlockCodec::Codec default_codec() {
+        return default_codec_ref();
+    }
+
+    RecordWriter() = default;
+
+    explicit RecordWriter(const std::string& filename, size_t bufferBytes = 1 << 16,
+                          BlockCodec::Codec codec = default_codec()) {
+        open(filename, bufferBytes, codec);
+    }
+
+    ~RecordWriter() {
+        close();
+    }
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    bool open(const std::string& filename, size_t bufferBytes = 1 << 16,
+              BlockCodec::Codec codec = default_codec()) {
+        close();
+        out.open(filename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            ErrorHandler::reportError("Could not open " + filename + " for writing.");
+            return false;
+        }
+        path = filename;
+        this->codec = codec;
+        if (codec != BlockCodec::Codec::None) {
+            out.write(BlockCodec::kMagic, BlockCodec::kMagicBytes);
+        }
+        flushThreshold = bufferBytes;
+        rawBytes = 0;
+        buffer.reserve(bufferBytes + kMaxVarintBytes * 2);
+        return true;
+    }
+
+    bool is_open() const {
+        return out.is_open();
+    }
+
+    // Record bytes written since open(), before compression.
+    uint64_t raw_bytes() const {
+        return rawBytes + buffer.size();
+    }
+
+    void write(std::string_view key, uint64_t count) {
+        append_record(buffer, key, count);
+        if (buffer.size() >= flushThreshold) {
+            flush();
+        }
+    }
+
+    // Appends bytes that are already in record format (e.g. a bucket built
+    // with append_record).
+    void write_encoded(std::string_view records) {
+        flush();
+        write_block(records);
+    }
+
+    // Both return false once any write to the file has failed (disk full,
+    // short write), so a caller never keeps a truncated file as complete.
+    bool flush() {
+        if (!buffer.empty()) {
+            write_block(buffer);
+            buffer.clear();
+        }
+        return !out.fail();
+    }
+
+    bool close() {
+        if (!out.is_open()) {
+            return true;
+        }
+        flush();
+        out.close();
+        if (out.fail()) {
+            ErrorHandler::reportError("Could not write " + path + ".");
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static BlockCodec::Codec& default_codec_ref() {
+        static BlockCodec::Codec codec = BlockCodec::Codec::None;
+        return codec;
+    }
+
+    void write_block(std::string_view bytes) {
+        rawBytes += bytes.size();
+        if (codec == BlockCodec::Codec::None) {
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            return;
+        }
+        frame.clear();
+        BlockCodec::append_frame(frame, bytes.data(), bytes.size());
+        out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    }
+
+    std::ofstream out;
+    std::string path;
+    std::string buffer;
+    std::string frame;
+    size_t flushThreshold = 1 << 16;
+    uint64_t rawBytes = 0;
+    BlockCodec::Codec codec = BlockCodec::Codec::None;
+};
+
+// Streaming reader for files written in the RecordWriter format. The file is
+// read in fixed-size blocks; a record split across two blocks is carried over
+// to the next refill, so memory use is bounded by the block size.
+class RecordReader {
+public:
+    // Decodes one varint from [pos, end). Returns false on a truncated or
+    // over-long varint and leaves pos untouched.
+    static bool read_varint(const char*& pos, const char* end, uint64_t& value) {
+        uint64_t result = 0;
+        const char* p = pos;
+        for (int shift = 0; shift < 64 && p < end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                value = result;
+                pos = p;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Decodes one record from [pos, end). The key view points into the input.
+    static bool read_record(const char*& pos, const char* end, std::string_view& key, uint64_t& count) {
+        const char* p = pos;
+        uint64_t keyLength;
+        if (!read_varint(p, end, keyLength) || static_cast<uint64_t>(end - p) < keyLength) {
+            return false;
+        }
+        std::string_view k(p, static_cast<size_t>(keyLength));
+        p += keyLength;
+        if (!read_varint(p, end, count)) {
+            return false;
+        }
+        key = k;
+        pos = p;
+        return true;
+    }
+
+    RecordReader() = default;
+
+    explicit RecordReader(const std::string& filename, size_t bufferBytes = 1 << 16) {
+        open(filename, bufferBytes);
+    }
+
+    bool open(const std::string& filename, size_t bufferBytes = 1 << 16) {
+        in.close();
+        in.clear();
+        in.open(filename, std::ios::binary);
+        if (!in) {
+            ErrorHandler::reportError("Could not open file " + filename + " for reading.");
+            return false;
+        }
+        buffer.resize(bufferBytes > 16 ? bufferBytes : 16);
+        begin = end = 0;
+        fileBytes = 0;
+        corrupt = false;
+        compressed = false;
+        frame.clear();
+        framePos = 0;
+
+        // Compressed files start with the codec header; plain files start
+        // with their first record, which stays in the buffer
+        in.read(buffer.data(), static_cast<std::streamsize>(BlockCodec::kMagicBytes));
+        end = static_cast<size_t>(in.gcount());
+        fileBytes = end;
+        if (BlockCodec::is_compressed_header(buffer.data(), end)) {
+            compressed = true;
+            end = 0;
+        }
+        return true;
+    }
+
+    bool is_open() const {
+        return in.is_open();
+    }
+
+    // Fetches the next record. The key view stays valid until the next call.
+    // Returns false at end of file or if the file ends mid-record (see
+    // truncated()).
+    bool next(std::string_view& key, uint64_t& count) {
+        return next_with([&key, &count](const char*& pos, const char* last) {
+            return read_record(pos, last, key, count);
+        });
+    }
+
+    // Same for records in another encoding (see Serializer.h):
+    // decode(pos, end) consumes one whole record from [pos, end) and returns
+    // true, or returns false without moving pos if the record is incomplete.
+    template <typename Decode>
+    bool next_with(Decode&& decode) {
+        while (true) {
+            const char* pos = buffer.data() + begin;
+            const char* last = buffer.data() + end;
+            if (decode(pos, last)) {
+                begin = static_cast<size_t>(pos - buffer.data());
+                return true;
+            }
+            if (!refill()) {
+                corrupt = corrupt || (begin != end);
+                return false;
+            }
+        }
+    }
+
+    bool truncated() const {
+        return corrupt;
+    }
+
+    // Bytes read from the file so far (compressed bytes for compressed files).
+    uint64_t bytes_read() const {
+        return fileBytes;
+    }
+
+private:
+    // Moves the unread tail to the front and reads more; grows the buffer
+    // when a single record does not fit.
+    bool refill() {
+        size_t remaining = end - begin;
+        if (remaining == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        } else if (begin > 0) {
+            std::memmove(buffer.data(), buffer.data() + begin, remaining);
+        }
+        begin = 0;
+        end = remaining;
+        size_t got = compressed ? read_frames(buffer.data() + end, buffer.size() - end)
+                                : read_plain(buffer.data() + end, buffer.size() - end);
+        end += got;
+        return got > 0;
+    }
+
+    size_t read_plain(char* out, size_t capacity) {
+        if (!in) {
+            return 0;
+        }
+        in.read(out, static_cast<std::streamsize>(capacity));
+        fileBytes += static_cast<uint64_t>(in.gcount());
+        return static_cast<size_t>(in.gcount());
+    }
+
+    // Copies decompressed bytes out, decoding the next frame whenever the
+    // current one is used up.
+    size_t read_frames(char* out, size_t capacity) {
+        size_t got = 0;
+        while (got < capacity) {
+            if (framePos == frame.size()) {
+                if (!next_frame()) {
+                    break;
+                }
+                continue;
+            }
+            size_t take = std::min(capacity - got, frame.size() - framePos);
+            std::memcpy(out + got, frame.data() + framePos, take);
+            framePos += take;
+            got += take;
+        }
+        return got;
+    }
+
+    bool next_frame() {
+        frame.clear();
+        framePos = 0;
+        uint64_t rawSize;
+        uint64_t storedSize;
+        if (!read_stream_varint(rawSize)) {
+            return false;  // clean end of file
+        }
+        if (!read_stream_varint(storedSize) || storedSize > rawSize) {
+            corrupt = true;
+            return false;
+        }
+        stored.resize(static_cast<size_t>(storedSize));
+        in.read(stored.data(), static_cast<std::streamsize>(storedSize));
+        fileBytes += static_cast<uint64_t>(in.gcount());
+        if (static_cast<uint64_t>(in.gcount()) != storedSize) {
+            corrupt = true;
+            return false;
+        }
+        frame.resize(static_cast<size_t>(rawSize));
+        if (storedSize == rawSize) {
+            std::memcpy(frame.data(), stored.data(), stored.size());
+        } else if (!BlockCodec::decompress(stored.data(), stored.size(), frame.data(), frame.size())) {
+            corrupt = true;
+            frame.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // A varint cut off by end of file counts as corruption unless no byte of
+    // it was read at all.
+    bool read_stream_varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int c = in.get();
+            if (c == std::char_traits<char>::eof()) {
+                corrupt = corrupt || shift > 0;
+                return false;
+            }
+            ++fileBytes;
+            value |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if ((c & 0x80) == 0) {
+                return true;
+            }
+        }
+        corrupt = true;
+        return false;
+    }
+
+    std::ifstream in;
+    std::vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t fileBytes = 0;
+    bool corrupt = false;
+    bool compressed = false;
+    std::vector<char> stored;   // compressed bytes of the current frame
+    std::vector<char> frame;    // decompressed bytes of the current frame
+    size_t framePos = 0;
+};
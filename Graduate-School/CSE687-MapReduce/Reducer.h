@@ -2,128 +2,171 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <thread>
 #include <iostream>
 #include <cstdlib>
-#include <queue>
-#include <condition_variable>
-#include <functional>
+#include <algorithm>
+#include "ERROR_Handler.h"
+#include "ExternalSort.h"
+#include "FileHandler.h"
+#include "FlatStringMap.h"
+#include "KernelLibrary.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "TaskChunking.h"
+#include "ThreadPool.h"
 
-class ThreadPool {
+class Reducer {
 public:
-    ThreadPool(size_t minThreads, size_t maxThreads)
-        : minThreads(minThreads), maxThreads(maxThreads), stopFlag(false) {
-        for (size_t i = 0; i < minThreads; ++i) {
-            addThread();
-        }
-    }
+    explicit Reducer(ThreadPool& pool = ThreadPool::getInstance())
+        : threadPool(pool) {}
 
-    ~ThreadPool() {
-        shutdown();
+    // With a kernel, reduce_partitions groups each partition's values by key
+    // and hands the groups to the kernel's reduce in batches.
+    void set_kernel(const mr_kernel* kernel) {
+        this->kernel = kernel;
     }
 
-    void enqueueTask(const std::function<void()>& task) {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            taskQueue.push(task);
+    void reduce(const std::vector<std::pair<std::string, uint64_t>>& mappedData, std::map<std::string, uint64_t>& reducedData) {
+        std::mutex mutex;
+        auto weight = [&mappedData](size_t i) { return mappedData[i].first.size() + sizeof(uint64_t); };
+        uint64_t totalBytes = 0;
+        for (size_t i = 0; i < mappedData.size(); ++i) {
+            totalBytes += weight(i);
         }
-        condition.notify_one();
-        adjustThreadPool();
-    }
+        auto chunks = TaskChunking::ranges(mappedData.size(),
+                                           TaskChunking::target_bytes(totalBytes, threadPool.size(), kMinChunkBytes), weight);
 
-    void shutdown() {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            stopFlag = true;
-        }
-        condition.notify_all();
-        for (std::thread& thread : threads) {
-            if (thread.joinable()) {
-                thread.join();
-            }
-        }
-    }
+        for (const auto& chunk : chunks) {
+            threadPool.enqueueTask([&mappedData, &reducedData, &mutex, chunk]() {
+                FlatStringMap<uint64_t> localReduce;
+
+                for (size_t j = chunk.first; j < chunk.second; ++j) {
+                    localReduce[mappedData[j].first] += mappedData[j].second;
+                }
 
-private:
-    void addThread() {
-        threads.emplace_back([this]() {
-            while (true) {
-                std::function<void()> task;
                 {
-                    std::unique_lock<std::mutex> lock(queueMutex);
-                    condition.wait(lock, [this]() {
-                        return stopFlag || !taskQueue.empty();
-                    });
-                    if (stopFlag && taskQueue.empty()) {
-                        return;
+                    std::lock_guard<std::mutex> lock(mutex); // Ensure thread-safe access to shared data
+                    for (const auto& kv : localReduce) {
+                        reducedData[std::string(kv.first)] += kv.second;
                     }
-                    task = std::move(taskQueue.front());
-                    taskQueue.pop();
                 }
-                task();
-            }
-        });
-    }
-
-    void adjustThreadPool() {
-        if (taskQueue.size() > threads.size() && threads.size() < maxThreads) {
-            addThread();
+            });
         }
-    }
-
-    std::vector<std::thread> threads;
-    std::queue<std::function<void()>> taskQueue;
-    std::mutex queueMutex;
-    std::condition_variable condition;
-    bool stopFlag;
-    size_t minThreads;
-    size_t maxThreads;
-};
-
-class Reducer {
-public:
-    Reducer(size_t minThreads = 2, size_t maxThreads = 8)
-        : threadPool(minThreads, maxThreads) {}
 
-    void reduce(const std::vector<std::pair<std::string, int>>& mappedData, std::map<std::string, int>& reducedData) {
-        std::mutex mutex;
-        size_t chunkSize = calculate_dynamic_chunk_size(mappedData.size());
-
-        for (size_t i = 0; i < mappedData.size(); i += chunkSize) {
-            threadPool.enqueueTask([this, &mappedData, &reducedData, &mutex, i, chunkSize]() {
-                size_t startIdx = i;
-                size_t endIdx = std::min(startIdx + chunkSize, mappedData.size());
-                std::map<std::string, int> localReduce;
+        threadPool.wait();
+    }
 
-                for (size_t j = startIdx; j < endIdx; ++j) {
-                    localReduce[mappedData[j].first] += mappedData[j].second;
+    // Reduce side of the shuffle: one task per spill file. Partitions hold
+    // disjoint key sets, so every task merges into its own table without any
+    // shared lock. Records are streamed straight from the spill file into
+    // the table; keys are only copied the first time they are seen. Inputs
+    // whose keys overlap (per-file partials from ResultCache) also work: the
+    // final merge sums counts a key has in several tables.
+    bool reduce_partitions(const std::vector<std::string>& spillPaths) {
+        std::vector<FlatStringMap<uint64_t>> partitionResults(spillPaths.size());
+        std::vector<char> succeeded(spillPaths.size(), 0);
+
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            threadPool.enqueueTask([this, &spillPaths, &partitionResults, &succeeded, p]() {
+                Metrics::TaskScope task("reduce", p);
+                Metrics::gauge("pool_queue", threadPool.queuedTaskCount());
+                RecordReader reader;
+                if (!reader.open(spillPaths[p])) {
+                    return;
                 }
-
-                {
-                    std::lock_guard<std::mutex> lock(mutex); // Ensure thread-safe access to shared data
-                    for (const auto& kv : localReduce) {
-                        reducedData[kv.first] += kv.second;
+                FlatStringMap<uint64_t>& localReduce = partitionResults[p];
+                FlatStringMap<std::vector<uint64_t>> groups;
+                std::string_view word;
+                uint64_t count;
+                uint64_t records = 0;
+                while (reader.next(word, count)) {
+                    ++records;
+                    if (word.empty()) {
+                        continue;
+                    }
+                    if (kernel != nullptr) {
+                        groups[word].push_back(count);
+                    } else {
+                        localReduce[word] += count;
                     }
                 }
+                Metrics::add(Metrics::BytesRead, reader.bytes_read());
+                Metrics::add(Metrics::RecordsIn, records);
+                if (reader.truncated()) {
+                    ErrorHandler::reportError("File " + spillPaths[p] + " ends in the middle of a record.");
+                    return;
+                }
+                if (kernel != nullptr && !KernelLibrary::reduce_groups(*kernel, groups, localReduce)) {
+                    ErrorHandler::reportError(std::string("Kernel ") + kernel->name + " failed to reduce " + spillPaths[p] + ".");
+                    return;
+                }
+                Metrics::add(Metrics::RecordsOut, localReduce.size());
+                succeeded[p] = 1;
             });
         }
 
-        threadPool.shutdown();
+        threadPool.wait();
+
+        reducedData.clear();
+        bool ok = true;
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            ok = ok && succeeded[p];
+            reducedData.merge(std::move(partitionResults[p]));
+        }
+        return ok;
     }
 
-private:
-    size_t calculate_dynamic_chunk_size(size_t totalSize) {
-        size_t numThreads = std::thread::hardware_concurrency();
-        size_t defaultChunkSize = 1024;
+    // Out-of-core variant for spill data larger than memoryBudget. Each
+    // partition is turned into sorted runs under runFolder by its own task
+    // (the budget is split between concurrently running tasks), then all
+    // runs are k-way merged and emit(key, count) is called once per word in
+    // ascending order. Nothing is kept in reducedData; run files are deleted.
+    template <typename Emit>
+    bool reduce_external(const std::vector<std::string>& spillPaths, const std::string& runFolder,
+                         size_t memoryBudget, Emit&& emit) {
+        std::vector<std::vector<std::string>> partitionRuns(spillPaths.size());
+        std::vector<char> succeeded(spillPaths.size(), 0);
+        size_t concurrent = std::min(spillPaths.size(), threadPool.size());
+        size_t taskBudget = memoryBudget / (concurrent > 0 ? concurrent : 1);
+
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            threadPool.enqueueTask([&spillPaths, &partitionRuns, &succeeded, &runFolder, taskBudget, p]() {
+                Metrics::TaskScope task("reduce_sort", p);
+                std::string runPrefix = runFolder + "/reduce_run_" + std::to_string(p);
+                if (ExternalSort::build_runs({spillPaths[p]}, runPrefix, taskBudget, partitionRuns[p])) {
+                    succeeded[p] = 1;
+                }
+            });
+        }
+
+        threadPool.wait();
 
-        if (numThreads == 0) {
-            return defaultChunkSize; // Fallback in case hardware_concurrency is not supported
+        std::vector<std::string> runs;
+        bool ok = true;
+        for (size_t p = 0; p < spillPaths.size(); ++p) {
+            ok = ok && succeeded[p];
+            runs.insert(runs.end(), partitionRuns[p].begin(), partitionRuns[p].end());
         }
+        Metrics::TaskScope task("reduce_merge", 0);
+        ok = ok && ExternalSort::reduce_fan_in(runs, runFolder + "/reduce_run_merged");
+        ok = ok && ExternalSort::merge_runs(runs, emit);
+        ExternalSort::remove_runs(runs);
+        reducedData.clear();
+        return ok;
+    }
 
-        size_t chunkSize = totalSize / numThreads;
-        return chunkSize > defaultChunkSize ? chunkSize : defaultChunkSize;
+    // Unordered; FileHandler::write_output sorts it once when writing.
+    const FlatStringMap<uint64_t>& get_reduced_data() const {
+        return reducedData;
     }
 
-    ThreadPool threadPool;
+private:
+    static constexpr uint64_t kMinChunkBytes = 64 * 1024;
+
+    ThreadPool& threadPool;
+    FlatStringMap<uint64_t> reducedData;
+    const mr_kernel* kernel = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,359 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include "Combiner.h"
+#include "ERROR_Handler.h"
+#include "Hash.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Mapper.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "TaskArena.h"
+#include "ThreadPool.h"
+
+// Persistent per-file map results for incremental reruns. Every input file
+// has its own partial word counts in the cache folder (one record file per
+// split of the file), listed in a manifest under the file's absolute path
+// together with its size, modification time and content hash:
+//
+//     mapreduce-result-cache <version> <next id>
+//     <id> <content hash> <size> <mtime> <parts> <record bytes> <path>
+//
+// update() re-maps only what changed. A file whose size and mtime match its
+// entry is reused without being read; one whose mtime moved but whose bytes
+// hash the same (touched, restored from backup) is reused after hashing.
+// Everything else is mapped again under a fresh id, and entries for files
+// that are gone are dropped. The partial files of all inputs then go to the
+// reducer, whose merge sums the counts a word has in several files.
+//
+// The manifest is replaced only after every new partial file is written, so
+// an interrupted run leaves the previous cache usable.
+class ResultCache {
+public:
+    // Bump whenever the same input would map to different records (tokenizer
+    // rules, record format); caches of another version are discarded.
+    static constexpr int kFormatVersion = 1;
+
+    explicit ResultCache(std::string folder, ThreadPool& pool = ThreadPool::getInstance())
+        : folder(std::move(folder)), threadPool(pool) {}
+
+    // Brings the cache in line with inputPaths and lists the partial files
+    // of every input in partial_paths(). Returns false if an input cannot be
+    // read or the cache cannot be written.
+    bool update(const std::vector<std::string>& inputPaths) {
+        namespace fs = std::filesystem;
+        partials.clear();
+        rawBytes = 0;
+        reused = 0;
+        mapped = 0;
+
+        std::error_code ec;
+        fs::create_directories(folder, ec);
+        if (ec) {
+            ErrorHandler::reportError("Could not create result cache folder " + folder + ".");
+            return false;
+        }
+        load_manifest();
+
+        // Stat every input. Files whose size and mtime still match are
+        // reused as they are; the rest are hashed
+        std::vector<std::string> keys(inputPaths.size());
+        std::vector<Entry> current(inputPaths.size());
+        std::vector<size_t> unsure;
+        for (size_t i = 0; i < inputPaths.size(); ++i) {
+            fs::path absolute = fs::absolute(inputPaths[i], ec);
+            keys[i] = ec ? inputPaths[i] : absolute.lexically_normal().string();
+            if (!stat(inputPaths[i], current[i])) {
+                return false;
+            }
+            auto found = entries.find(keys[i]);
+            if (found != entries.end() && found->second.size == current[i].size &&
+                found->second.mtime == current[i].mtime && parts_exist(found->second)) {
+                current[i] = found->second;
+            } else {
+                unsure.push_back(i);
+            }
+        }
+
+        std::vector<char> hashed(inputPaths.size(), 0);
+        for (size_t i : unsure) {
+            threadPool.enqueueTask([&inputPaths, &current, &hashed, i]() {
+                Metrics::TaskScope task("cache_hash", i);
+                MappedFile file;
+                if (!file.open(inputPaths[i])) {
+                    return;
+                }
+                current[i].hash = Hash::content(file.view());
+                Metrics::add(Metrics::BytesRead, file.size());
+                hashed[i] = 1;
+            });
+        }
+        threadPool.wait();
+
+        std::vector<size_t> changed;
+        for (size_t i : unsure) {
+            if (!hashed[i]) {
+                return false;
+            }
+            auto found = entries.find(keys[i]);
+            if (found != entries.end() && found->second.size == current[i].size &&
+                found->second.hash == current[i].hash && parts_exist(found->second)) {
+                current[i].id = found->second.id;
+                current[i].parts = found->second.parts;
+                current[i].rawBytes = found->second.rawBytes;
+            } else {
+                current[i].id = nextId++;
+                changed.push_back(i);
+            }
+        }
+
+        if (!map_files(inputPaths, changed, current)) {
+            for (size_t i : changed) {
+                remove_parts(current[i]);
+            }
+            return false;
+        }
+
+        // Partial files of replaced or vanished inputs are no longer needed
+        std::map<std::string, Entry> updated;
+        for (size_t i = 0; i < inputPaths.size(); ++i) {
+            updated[keys[i]] = current[i];
+        }
+        for (const auto& kv : entries) {
+            auto kept = updated.find(kv.first);
+            if (kept == updated.end() || kept->second.id != kv.second.id) {
+                remove_parts(kv.second);
+            }
+        }
+        entries = std::move(updated);
+        if (!save_manifest()) {
+            return false;
+        }
+
+        for (const Entry& entry : current) {
+            for (uint64_t part = 0; part < entry.parts; ++part) {
+                partials.push_back(part_path(entry.id, part));
+            }
+            rawBytes += entry.rawBytes;
+        }
+        mapped = changed.size();
+        reused = inputPaths.size() - mapped;
+        return true;
+    }
+
+    // Partial record files of every input, in input order.
+    const std::vector<std::string>& partial_paths() const {
+        return partials;
+    }
+
+    // Record bytes (before compression) across partial_paths().
+    uint64_t raw_bytes() const {
+        return rawBytes;
+    }
+
+    size_t reused_files() const {
+        return reused;
+    }
+
+    size_t mapped_files() const {
+        return mapped;
+    }
+
+private:
+    struct Entry {
+        uint64_t id = 0;
+        uint64_t hash = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t parts = 0;
+        uint64_t rawBytes = 0;
+    };
+
+    static constexpr const char* kManifestTag = "mapreduce-result-cache";
+
+    std::string manifest_path() const {
+        return folder + "/manifest.txt";
+    }
+
+    std::string part_path(uint64_t id, uint64_t part) const {
+        return folder + "/partial_" + std::to_string(id) + "_" + std::to_string(part) + ".bin";
+    }
+
+    static bool stat(const std::string& path, Entry& entry) {
+        std::error_code sizeError;
+        std::error_code timeError;
+        entry.size = std::filesystem::file_size(path, sizeError);
+        auto modified = std::filesystem::last_write_time(path, timeError);
+        if (sizeError || timeError) {
+            ErrorHandler::reportError("Could not stat input file " + path + ".");
+            return false;
+        }
+        entry.mtime = static_cast<int64_t>(modified.time_since_epoch().count());
+        return true;
+    }
+
+    bool parts_exist(const Entry& entry) const {
+        std::error_code ec;
+        for (uint64_t part = 0; part < entry.parts; ++part) {
+            if (!std::filesystem::exists(part_path(entry.id, part), ec)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void remove_parts(const Entry& entry) const {
+        std::error_code ec;
+        for (uint64_t part = 0; part < entry.parts; ++part) {
+            std::filesystem::remove(part_path(entry.id, part), ec);
+        }
+    }
+
+    // Maps the changed files, one task per split, each writing its combined
+    // counts to its own partial file.
+    bool map_files(const std::vector<std::string>& inputPaths, const std::vector<size_t>& changed,
+                   std::vector<Entry>& current) {
+        std::vector<InputSplit> splits;
+        std::vector<size_t> owners;
+        uint64_t changedBytes = 0;
+        for (size_t i : changed) {
+            changedBytes += current[i].size;
+        }
+        uint64_t splitBytes = InputSplit::default_split_bytes(changedBytes, threadPool.size());
+        for (size_t i : changed) {
+            current[i].parts = 0;
+            current[i].rawBytes = 0;
+            if (!InputSplit::plan({inputPaths[i]}, splitBytes, splits)) {
+                return false;
+            }
+            owners.resize(splits.size(), i);
+        }
+
+        std::vector<uint64_t> parts(splits.size());
+        for (size_t t = 0; t < splits.size(); ++t) {
+            parts[t] = current[owners[t]].parts++;
+        }
+
+        std::vector<uint64_t> splitBytesOut(splits.size(), 0);
+        std::vector<char> succeeded(splits.size(), 0);
+        for (size_t t = 0; t < splits.size(); ++t) {
+            std::string path = part_path(current[owners[t]].id, parts[t]);
+            threadPool.enqueueTask([&splits, &splitBytesOut, &succeeded, path, t]() {
+                Metrics::TaskScope task("map", t);
+                MappedFile file;
+                RecordWriter writer;
+                if (!file.open(splits[t].path) || !writer.open(path)) {
+                    return;
+                }
+                TaskArena arena;
+                Combiner combiner([&writer](const Combiner& partial) {
+                    for (const auto& kv : partial) {
+                        writer.write(kv.first, kv.second);
+                    }
+                    Metrics::add(Metrics::RecordsOut, partial.size());
+                }, Combiner::kDefaultEntries, arena.resource());
+                std::pmr::string scratch(arena.resource());
+                Mapper::map_text(MappedFile::line_range(file.view(), splits[t].offset, splits[t].length), combiner, scratch);
+                combiner.flush();
+                splitBytesOut[t] = writer.raw_bytes();
+                if (writer.close()) {
+                    succeeded[t] = 1;
+                }
+            });
+        }
+        threadPool.wait();
+
+        bool ok = true;
+        for (size_t t = 0; t < splits.size(); ++t) {
+            ok = ok && succeeded[t];
+            current[owners[t]].rawBytes += splitBytesOut[t];
+        }
+        return ok;
+    }
+
+    // A missing, unreadable or other-version manifest starts an empty cache
+    // and clears out whatever partial files it left behind.
+    void load_manifest() {
+        entries.clear();
+        nextId = 0;
+        std::ifstream in(manifest_path());
+        std::string line;
+        std::string tag;
+        int version = 0;
+        bool valid = false;
+        if (in && std::getline(in, line)) {
+            std::istringstream header(line);
+            valid = (header >> tag >> version >> nextId) && tag == kManifestTag && version == kFormatVersion;
+        }
+        while (valid && std::getline(in, line)) {
+            std::istringstream fields(line);
+            Entry entry;
+            std::string path;
+            if (!(fields >> entry.id >> entry.hash >> entry.size >> entry.mtime >> entry.parts >> entry.rawBytes) ||
+                fields.get() != ' ' || !std::getline(fields, path) || path.empty()) {
+                valid = false;
+                break;
+            }
+            entries[path] = entry;
+        }
+        if (valid) {
+            return;
+        }
+
+        entries.clear();
+        nextId = 0;
+        std::error_code ec;
+        for (const auto& file : std::filesystem::directory_iterator(folder, ec)) {
+            if (file.path().filename().string().rfind("partial_", 0) == 0) {
+                std::error_code removeError;
+                std::filesystem::remove(file.path(), removeError);
+            }
+        }
+    }
+
+    // Written next to the old manifest and renamed over it.
+    bool save_manifest() const {
+        std::string path = manifest_path();
+        std::string staged = path + ".tmp";
+        {
+            std::ofstream out(staged, std::ios::trunc);
+            if (!out) {
+                ErrorHandler::reportError("Could not open " + staged + " for writing.");
+                return false;
+            }
+            out << kManifestTag << ' ' << kFormatVersion << ' ' << nextId << '\n';
+            for (const auto& kv : entries) {
+                const Entry& entry = kv.second;
+                out << entry.id << ' ' << entry.hash << ' ' << entry.size << ' ' << entry.mtime << ' '
+                    << entry.parts << ' ' << entry.rawBytes << ' ' << kv.first << '\n';
+            }
+            if (!out.flush()) {
+                ErrorHandler::reportError("Could not write " + staged + ".");
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(staged, path, ec);
+        if (ec) {
+            ErrorHandler::reportError("Could not replace " + path + ".");
+            return false;
+        }
+        return true;
+    }
+
+    std::string folder;
+    ThreadPool& threadPool;
+    std::map<std::string, Entry> entries;   // by absolute input path
+    uint64_t nextId = 0;
+    std::vector<std::string> partials;
+    uint64_t rawBytes = 0;
+    size_t reused = 0;
+    size_t mapped = 0;
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include "Hash.h"
+#include "RecordIO.h"
+
+// Binary encoding and hashing of typed keys and values for Job (Job.h).
+// Both are picked at compile time per type, so a job over integers or
+// tuples never formats its data as text and parses it back:
+//
+//     unsigned integers   varint
+//     signed integers     zigzag varint
+//     float / double      raw bytes
+//     std::string         varint(length) | bytes
+//     std::pair<A, B>     A | B
+//     std::vector<T>      varint(size) | T...
+//
+// Serializer<T>::read decodes one value from [pos, end). On a truncated
+// value it returns false and leaves pos where it was, which is what
+// RecordReader::next_with needs to refill and retry. Other types get their
+// own specialization; an unsupported type fails to compile.
+template <typename T, typename Enable = void>
+struct Serializer;
+
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>>> {
+    static void write(std::string& out, T value) {
+        RecordWriter::append_varint(out, static_cast<uint64_t>(value));
+    }
+
+    static bool read(const char*& pos, const char* end, T& value) {
+        uint64_t raw;
+        if (!RecordReader::read_varint(pos, end, raw)) {
+            return false;
+        }
+        value = static_cast<T>(raw);
+        return true;
+    }
+};
+
+// Zigzag keeps small negative numbers short: 0, -1, 1, -2 -> 0, 1, 2, 3.
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>>> {
+    static void write(std::string& out, T value) {
+        uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(value));
+        RecordWriter::append_varint(out, (bits << 1) ^ (value < 0 ? ~uint64_t(0) : 0));
+    }
+
+    static bool read(const char*& pos, const char* end, T& value) {
+        uint64_t raw;
+        if (!RecordReader::read_varint(pos, end, raw)) {
+            return false;
+        }
+        value = static_cast<T>(static_cast<int64_t>((raw >> 1) ^ (~(raw & 1) + 1)));
+        return true;
+    }
+};
+
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static void write(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    static bool read(const char*& pos, const char* end, T& value) {
+        if (static_cast<size_t>(end - pos) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+template <>
+struct Serializer<std::string> {
+    static void write(std::string& out, const std::string& value) {
+        RecordWriter::append_varint(out, value.size());
+        out.append(value);
+    }
+
+    static bool read(const char*& pos, const char* end, std::string& value) {
+        const char* p = pos;
+        uint64_t length;
+        if (!RecordReader::read_varint(p, end, length) || static_cast<uint64_t>(end - p) < length) {
+            return false;
+        }
+        value.assign(p, static_cast<size_t>(length));
+        pos = p + length;
+        return true;
+    }
+};
+
+template <typename A, typename B>
+struct Serializer<std::pair<A, B>> {
+    static void write(std::string& out, const std::pair<A, B>& value) {
+        Serializer<A>::write(out, value.first);
+        Serializer<B>::write(out, value.second);
+    }
+
+    static bool read(const char*& pos, const char* end, std::pair<A, B>& value) {
+        const char* p = pos;
+        if (!Serializer<A>::read(p, end, value.first) || !Serializer<B>::read(p, end, value.second)) {
+            return false;
+        }
+        pos = p;
+        return true;
+    }
+};
+
+template <typename T>
+struct Serializer<std::vector<T>> {
+    static void write(std::string& out, const std::vector<T>& value) {
+        RecordWriter::append_varint(out, value.size());
+        for (const T& element : value) {
+            Serializer<T>::write(out, element);
+        }
+    }
+
+    static bool read(const char*& pos, const char* end, std::vector<T>& value) {
+        const char* p = pos;
+        uint64_t size;
+        // Every element takes at least one byte, which bounds a corrupt size
+        if (!RecordReader::read_varint(p, end, size) || static_cast<uint64_t>(end - p) < size) {
+            return false;
+        }
+        value.resize(static_cast<size_t>(size));
+        for (T& element : value) {
+            if (!Serializer<T>::read(p, end, element)) {
+                return false;
+            }
+        }
+        pos = p;
+        return true;
+    }
+};
+
+// Hasher<T> routes keys to partitions and indexes the job's tables. Like
+// Hash.h it is stable across runs and processes, unlike std::hash.
+template <typename T, typename Enable = void>
+struct Hasher;
+
+template <typename T>
+struct Hasher<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>> {
+    static uint64_t hash(T value) {
+        return Hash::mix(static_cast<uint64_t>(value));
+    }
+
+    size_t operator()(T value) const {
+        return static_cast<size_t>(hash(value));
+    }
+};
+
+template <typename T>
+struct Hasher<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static uint64_t hash(T value) {
+        // 0.0 and -0.0 compare equal, so they must hash the same
+        double wide = value == 0 ? 0.0 : static_cast<double>(value);
+        uint64_t bits;
+        std::memcpy(&bits, &wide, sizeof(bits));
+        return Hash::mix(bits);
+    }
+
+    size_t operator()(T value) const {
+        return static_cast<size_t>(hash(value));
+    }
+};
+
+template <>
+struct Hasher<std::string> {
+    static uint64_t hash(const std::string& value) {
+        return Hash::mix(Hash::fnv1a(value));
+    }
+
+    size_t operator()(const std::string& value) const {
+        return static_cast<size_t>(hash(value));
+    }
+};
+
+template <typename A, typename B>
+struct Hasher<std::pair<A, B>> {
+    static uint64_t hash(const std::pair<A, B>& value) {
+        uint64_t first = Hasher<A>::hash(value.first);
+        return Hash::mix(first ^ (Hasher<B>::hash(value.second) + 0x9e3779b97f4a7c15ull + (first << 6) + (first >> 2)));
+    }
+
+    size_t operator()(const std::pair<A, B>& value) const {
+        return static_cast<size_t>(hash(value));
+    }
+};
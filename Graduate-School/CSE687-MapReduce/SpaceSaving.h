@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "FlatStringMap.h"
+
+// Space-Saving heavy-hitters summary with at most `capacity` counters,
+// kept as a mergeable summary: every counter holds an upper bound on its
+// key's true count and the slack in that bound, and untracked_bound() caps
+// the count of any key without a counter. For N total occurrences the
+// slack never exceeds N / capacity, so any key more frequent than that is
+// guaranteed to be tracked.
+//
+// Updates arrive in batches (a Combiner's exact partial counts, or another
+// summary) rather than per token: merging unions the counters, charges a
+// key missing from one side that side's untracked bound, and keeps the
+// `capacity` largest. Memory is O(capacity) whatever the vocabulary size.
+class SpaceSaving {
+public:
+    struct Counter {
+        std::string key;
+        uint64_t count;   // upper bound on the true count
+        uint64_t error;   // count - error is a lower bound
+    };
+
+    explicit SpaceSaving(size_t capacity = 1024)
+        : capacity(capacity > 0 ? capacity : 1) {}
+
+    // Folds in exact counts for one batch. Counts is any iterable of
+    // (key, count) pairs with distinct keys.
+    template <typename Counts>
+    void add_exact(const Counts& counts) {
+        std::vector<Counter> batch;
+        for (const auto& kv : counts) {
+            batch.push_back(Counter{std::string(kv.first), static_cast<uint64_t>(kv.second), 0});
+        }
+        merge_counters(std::move(batch), 0);
+    }
+
+    void merge(const SpaceSaving& other) {
+        merge_counters(other.counters, other.untracked);
+    }
+
+    // Upper bound on the count of any key that has no counter.
+    uint64_t untracked_bound() const {
+        return untracked;
+    }
+
+    const std::vector<Counter>& get_counters() const {
+        return counters;
+    }
+
+    size_t get_capacity() const {
+        return capacity;
+    }
+
+    // The k counters with the largest upper bounds, largest first (ties by
+    // key).
+    std::vector<Counter> top(size_t k) const {
+        std::vector<Counter> ranked = counters;
+        std::sort(ranked.begin(), ranked.end(), by_count);
+        if (ranked.size() > k) {
+            ranked.resize(k);
+        }
+        return ranked;
+    }
+
+private:
+    static bool by_count(const Counter& a, const Counter& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    }
+
+    void merge_counters(std::vector<Counter> incoming, uint64_t incomingUntracked) {
+        FlatStringMap<size_t> position(counters.size());
+        for (size_t i = 0; i < counters.size(); ++i) {
+            position[counters[i].key] = i + 1;
+        }
+        std::vector<char> matched(counters.size(), 0);
+        std::vector<Counter> merged;
+        merged.reserve(counters.size() + incoming.size());
+        for (Counter& counter : incoming) {
+            const size_t* mine = position.find(counter.key);
+            if (mine != nullptr) {
+                const Counter& own = counters[*mine - 1];
+                matched[*mine - 1] = 1;
+                merged.push_back(Counter{std::move(counter.key), own.count + counter.count, own.error + counter.error});
+            } else {
+                merged.push_back(Counter{std::move(counter.key), counter.count + untracked, counter.error + untracked});
+            }
+        }
+        for (size_t i = 0; i < counters.size(); ++i) {
+            if (!matched[i]) {
+                Counter& own = counters[i];
+                merged.push_back(Counter{std::move(own.key), own.count + incomingUntracked, own.error + incomingUntracked});
+            }
+        }
+
+        // A key absent from both sides is bounded by both untracked bounds;
+        // a dropped counter raises the bound to its own count
+        uint64_t bound = untracked + incomingUntracked;
+        if (merged.size() > capacity) {
+            std::nth_element(merged.begin(), merged.begin() + capacity, merged.end(), by_count);
+            for (size_t i = capacity; i < merged.size(); ++i) {
+                bound = std::max(bound, merged[i].count);
+            }
+            merged.resize(capacity);
+        }
+        counters = std::move(merged);
+        untracked = bound;
+    }
+
+    size_t capacity;
+    std::vector<Counter> counters;
+    uint64_t untracked = 0;
+};
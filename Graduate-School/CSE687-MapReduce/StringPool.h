@@ -0,0 +1,137 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstring>
+#include <cstddef>
+
+// Bump-pointer arena for key bytes. Tables copy each distinct key in here
+// once and keep a std::string_view to it, so there is no per-key heap
+// allocation and keys of one table sit next to each other in memory. Views
+// stay valid until clear() or destruction; blocks never move, so a pool can
+// also be handed to another pool with adopt() without invalidating them.
+// Blocks come from resource. clear() hands them back, so a pool that is
+// cleared over and over needs a resource that reuses freed memory, not a
+// monotonic one.
+class StringPool {
+public:
+    explicit StringPool(size_t blockBytes = 64 * 1024,
+                        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : blockBytes(blockBytes > 0 ? blockBytes : 1), resource(resource) {}
+
+    ~StringPool() {
+        release(0);
+    }
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    StringPool(StringPool&& other) noexcept
+        : blocks(std::move(other.blocks)), cursor(other.cursor), remaining(other.remaining), used(other.used),
+          blockBytes(other.blockBytes), resource(other.resource) {
+        other.blocks.clear();
+        other.cursor = nullptr;
+        other.remaining = 0;
+        other.used = 0;
+    }
+
+    StringPool& operator=(StringPool&& other) noexcept {
+        if (this != &other) {
+            release(0);
+            blocks.swap(other.blocks);
+            cursor = other.cursor;
+            remaining = other.remaining;
+            used = other.used;
+            blockBytes = other.blockBytes;
+            resource = other.resource;
+            other.cursor = nullptr;
+            other.remaining = 0;
+            other.used = 0;
+        }
+        return *this;
+    }
+
+    std::string_view intern(std::string_view text) {
+        if (text.size() > remaining) {
+            if (text.size() > blockBytes / 4) {
+                // Oversized strings get their own block; the current block
+                // keeps serving small keys
+                blocks.push_back(Block{allocate(text.size()), text.size(), resource});
+                std::memcpy(blocks.back().data, text.data(), text.size());
+                used += text.size();
+                std::string_view stored(blocks.back().data, text.size());
+                if (blocks.size() > 1) {
+                    std::swap(blocks[blocks.size() - 1], blocks[blocks.size() - 2]);
+                }
+                return stored;
+            }
+            blocks.push_back(Block{allocate(blockBytes), blockBytes, resource});
+            cursor = blocks.back().data;
+            remaining = blockBytes;
+        }
+        char* destination = cursor;
+        std::memcpy(destination, text.data(), text.size());
+        cursor += text.size();
+        remaining -= text.size();
+        used += text.size();
+        return std::string_view(destination, text.size());
+    }
+
+    // Takes over other's blocks; views into other remain valid. Each block
+    // is returned to the resource it came from.
+    void adopt(StringPool&& other) {
+        blocks.insert(blocks.begin(), other.blocks.rbegin(), other.blocks.rend());
+        used += other.used;
+        other.blocks.clear();
+        other.cursor = nullptr;
+        other.remaining = 0;
+        other.used = 0;
+    }
+
+    // Releases every key at once. The current (last) block is kept for reuse
+    // when it is a regular one.
+    void clear() {
+        if (!blocks.empty() && cursor != nullptr && blocks.back().size == blockBytes &&
+            cursor + remaining == blocks.back().data + blockBytes) {
+            release(1);
+            cursor = blocks.back().data;
+            remaining = blockBytes;
+        } else {
+            release(0);
+            cursor = nullptr;
+            remaining = 0;
+        }
+        used = 0;
+    }
+
+    size_t bytes_used() const {
+        return used;
+    }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+        std::pmr::memory_resource* resource;
+    };
+
+    char* allocate(size_t bytes) {
+        return static_cast<char*>(resource->allocate(bytes, 1));
+    }
+
+    // Frees all blocks but the last keep of them.
+    void release(size_t keep) {
+        size_t drop = blocks.size() > keep ? blocks.size() - keep : 0;
+        for (size_t i = 0; i < drop; ++i) {
+            blocks[i].resource->deallocate(blocks[i].data, blocks[i].size, 1);
+        }
+        blocks.erase(blocks.begin(), blocks.begin() + static_cast<std::ptrdiff_t>(drop));
+    }
+
+    std::vector<Block> blocks;  // current block is last
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t used = 0;
+    size_t blockBytes;
+    std::pmr::memory_resource* resource;
+};
@@ -0,0 +1,93 @@
+#include "BlockCodec.h"
+#include "PartitionedSpill.h"
+#include "RecordIO.h"
+#include "TEST_Test_Framework.h"
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool round_trips(const std::string& raw) {
+    std::string compressed(BlockCodec::compress_bound(raw.size()), '\0');
+    size_t size = BlockCodec::compress(raw.data(), raw.size(), &compressed[0]);
+    std::string restored(raw.size(), '\0');
+    return BlockCodec::decompress(compressed.data(), size, &restored[0], restored.size()) && restored == raw;
+}
+
+TEST_CASE(BlockCodecTests) {
+    // Edge sizes, long runs (overlapping matches) and random bytes
+    std::mt19937 rng(7);
+    std::string random(100000, '\0');
+    for (char& c : random) {
+        c = static_cast<char>(rng());
+    }
+    ASSERT_TRUE(round_trips(""));
+    ASSERT_TRUE(round_trips("a"));
+    ASSERT_TRUE(round_trips("abcdefghijklm"));
+    ASSERT_TRUE(round_trips(std::string(70000, 'z')));
+    ASSERT_TRUE(round_trips(random));
+
+    // Word-count records compress well
+    std::string records;
+    for (int i = 0; i < 20000; ++i) {
+        RecordWriter::append_record(records, "word" + std::to_string(i % 300), 1 + i % 3);
+    }
+    std::string compressed(BlockCodec::compress_bound(records.size()), '\0');
+    size_t size = BlockCodec::compress(records.data(), records.size(), &compressed[0]);
+    ASSERT_TRUE(size * 3 < records.size());
+
+    // Malformed blocks are rejected rather than overrunning the output
+    std::string restored(records.size(), '\0');
+    ASSERT_TRUE(!BlockCodec::decompress(compressed.data(), size / 2, &restored[0], restored.size()));
+    ASSERT_TRUE(!BlockCodec::decompress(compressed.data(), size, &restored[0], restored.size() - 1));
+
+    // Compressed writer and spill files read back through the same reader
+    // as plain ones
+    std::string path = "./block_codec_test.bin";
+    {
+        RecordWriter writer(path, 256, BlockCodec::Codec::LZ4);
+        for (int i = 0; i < 5000; ++i) {
+            writer.write("key" + std::to_string(i % 50), static_cast<uint64_t>(i));
+        }
+    }
+    RecordReader reader(path, 64);
+    std::string_view key;
+    uint64_t count;
+    uint64_t total = 0;
+    int n = 0;
+    bool keysMatch = true;
+    while (reader.next(key, count)) {
+        keysMatch = keysMatch && key == "key" + std::to_string(n % 50);
+        total += count;
+        ++n;
+    }
+    ASSERT_TRUE(keysMatch);
+    ASSERT_TRUE(!reader.truncated());
+    ASSERT_EQ(5000, n);
+    ASSERT_EQ(uint64_t(4999) * 5000 / 2, total);
+
+    PartitionedSpill spill(PartitionedSpill::spill_paths("./block_codec_spill", 2), BlockCodec::Codec::LZ4);
+    ASSERT_TRUE(spill.open());
+    std::vector<std::pair<std::string, int>> counts = {{"alpha", 2}, {"beta", 3}, {"gamma", 4}};
+    spill.spill(counts);
+    spill.spill(counts);
+    ASSERT_TRUE(spill.close());
+    int summed = 0;
+    for (const std::string& spillPath : spill.paths()) {
+        RecordReader spillReader(spillPath);
+        while (spillReader.next(key, count)) {
+            summed += static_cast<int>(count);
+        }
+        ASSERT_TRUE(!spillReader.truncated());
+    }
+    ASSERT_EQ(18, summed);
+
+    // A compressed file cut mid-frame is reported as truncated
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() - 3);
+    RecordReader cut(path);
+    while (cut.next(key, count)) {
+    }
+    ASSERT_TRUE(cut.truncated());
+}
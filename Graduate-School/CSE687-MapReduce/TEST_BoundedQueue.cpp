@@ -0,0 +1,57 @@
+#include "BoundedQueue.h"
+#include "TEST_Test_Framework.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE(BoundedQueueTests) {
+    // Capacity rounds up to a power of two and try_push fails when full
+    BoundedQueue<int> small(3);
+    ASSERT_EQ(4u, small.capacity());
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(small.try_push(i));
+    }
+    int extra = 99;
+    ASSERT_TRUE(!small.try_push(extra));
+    int value = -1;
+    ASSERT_TRUE(small.try_pop(value));
+    ASSERT_EQ(0, value);
+
+    // Several producers and consumers through a queue much smaller than the
+    // stream; every item arrives exactly once
+    BoundedQueue<long> queue(8);
+    const int producers = 4;
+    const int perProducer = 20000;
+    std::atomic<long> sum{0};
+    std::atomic<long> received{0};
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 3; ++c) {
+        consumers.emplace_back([&]() {
+            long item;
+            while (queue.pop(item)) {
+                sum += item;
+                received++;
+            }
+        });
+    }
+    std::vector<std::thread> senders;
+    for (int p = 0; p < producers; ++p) {
+        senders.emplace_back([&queue, p]() {
+            for (int i = 1; i <= perProducer; ++i) {
+                queue.push(static_cast<long>(p) * perProducer + i);
+            }
+        });
+    }
+    for (auto& sender : senders) {
+        sender.join();
+    }
+    queue.close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    long n = static_cast<long>(producers) * perProducer;
+    ASSERT_EQ(n, received.load());
+    ASSERT_EQ(n * (n + 1) / 2, sum.load());
+}
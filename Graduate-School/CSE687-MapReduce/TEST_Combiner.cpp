@@ -0,0 +1,41 @@
+#include "Combiner.h"
+#include "TEST_Test_Framework.h"
+#include <map>
+#include <string>
+
+TEST_CASE(CombinerTests) {
+    std::map<std::string, uint64_t> spilled;
+    size_t sinkCalls = 0;
+    Combiner combiner([&](const Combiner& partial) {
+        ++sinkCalls;
+        for (const auto& kv : partial) {
+            spilled[std::string(kv.first)] += kv.second;
+        }
+    }, 4);
+
+    // Repeated keys are summed without touching the sink
+    combiner.add("the");
+    combiner.add("the");
+    combiner.add("cat", 2);
+    ASSERT_EQ(2u, combiner.size());
+    ASSERT_EQ(0u, sinkCalls);
+
+    // A fifth distinct key forces a spill of the four already buffered
+    combiner.add("sat");
+    combiner.add("on");
+    combiner.add("mat");
+    ASSERT_EQ(1u, sinkCalls);
+    ASSERT_EQ(1u, combiner.size());
+
+    combiner.add("the");
+    combiner.flush();
+    ASSERT_EQ(2u, sinkCalls);
+    ASSERT_TRUE(combiner.empty());
+    ASSERT_EQ(3u, spilled["the"]);
+    ASSERT_EQ(2u, spilled["cat"]);
+    ASSERT_EQ(1u, spilled["mat"]);
+
+    // Flushing an empty table does not call the sink
+    combiner.flush();
+    ASSERT_EQ(2u, sinkCalls);
+}
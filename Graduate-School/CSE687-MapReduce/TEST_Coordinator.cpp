@@ -0,0 +1,73 @@
+#include "Coordinator.h"
+#include "TEST_Test_Framework.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_CASE(CoordinatorTests) {
+    std::string folder = "./coordinator_test";
+    std::filesystem::create_directories(folder);
+    std::vector<std::string> inputs = {folder + "/a.txt", folder + "/b.txt"};
+    std::ofstream(inputs[0], std::ios::binary) << "one two two\nthree three three\n";
+    std::ofstream(inputs[1], std::ios::binary) << "Two, ONE!\r\nfour\n";
+
+    std::vector<InputSplit> splits;
+    ASSERT_TRUE(InputSplit::plan(inputs, 8, splits));
+
+    // The first worker to run map task 1 dies; the task must be re-run on a
+    // replacement worker and the counts must come out unchanged
+    Coordinator::Options options;
+    options.workers = 3;
+    options.crashTask = 1;
+    Coordinator coordinator(options);
+    FlatStringMap<uint64_t> result;
+    ASSERT_TRUE(coordinator.run(splits, folder, 4, result));
+    ASSERT_EQ(1u, coordinator.restarts());
+    ASSERT_EQ(4u, result.size());
+    ASSERT_EQ(2u, *result.find("one"));
+    ASSERT_EQ(3u, *result.find("two"));
+    ASSERT_EQ(3u, *result.find("three"));
+    ASSERT_EQ(1u, *result.find("four"));
+
+    // A task that keeps failing fails the job instead of looping
+    std::vector<InputSplit> missing = {InputSplit{folder + "/missing.txt", 0, 10}};
+    Coordinator::Options strict;
+    strict.workers = 2;
+    strict.maxAttempts = 2;
+    Coordinator failing(strict);
+    ASSERT_TRUE(!failing.run(missing, folder, 2, result));
+
+    // A job that dies in reduce resumes there: the map tasks and the
+    // reduce tasks that finished are not run again
+    Coordinator::Options dying;
+    dying.workers = 2;
+    dying.maxAttempts = 1;
+    dying.resume = true;
+    dying.crashPartition = 2;
+    ASSERT_TRUE(!Coordinator(dying).run(splits, folder, 4, result));
+    Coordinator::Options resuming;
+    resuming.workers = 2;
+    resuming.resume = true;
+    Coordinator resumed(resuming);
+    ASSERT_TRUE(resumed.run(splits, folder, 4, result));
+    ASSERT_TRUE(resumed.resumed_tasks() >= splits.size());
+    ASSERT_TRUE(resumed.resumed_tasks() < splits.size() + 4);
+    ASSERT_EQ(3u, *result.find("two"));
+    ASSERT_TRUE(resumed.run(splits, folder, 4, result));
+    ASSERT_EQ(splits.size() + 4, resumed.resumed_tasks());
+
+    // A damaged spill file re-runs its map task and every reduce task
+    std::ofstream(Coordinator::map_output_base(folder, 0) + "_1.bin", std::ios::app) << "x";
+    ASSERT_TRUE(resumed.run(splits, folder, 4, result));
+    ASSERT_EQ(splits.size() - 1, resumed.resumed_tasks());
+    ASSERT_EQ(4u, result.size());
+    ASSERT_EQ(2u, *result.find("one"));
+
+    // A different plan starts over
+    ASSERT_TRUE(resumed.run(splits, folder, 3, result));
+    ASSERT_EQ(0u, resumed.resumed_tasks());
+    ASSERT_EQ(1u, *result.find("four"));
+
+    std::filesystem::remove_all(folder);
+}
@@ -0,0 +1,42 @@
+#include "ExternalSort.h"
+#include "RecordIO.h"
+#include "TEST_Test_Framework.h"
+#include <map>
+#include <string>
+#include <vector>
+
+TEST_CASE(ExternalSortTests) {
+    // Two unsorted spill files with overlapping keys
+    std::map<std::string, uint64_t> expected;
+    std::vector<std::string> inputs = {"./external_sort_in_0.bin", "./external_sort_in_1.bin"};
+    for (size_t f = 0; f < inputs.size(); ++f) {
+        RecordWriter writer(inputs[f]);
+        for (int i = 0; i < 5000; ++i) {
+            std::string key = "k" + std::to_string((i * 7919 + f) % 1500);
+            writer.write(key, 1);
+            expected[key] += 1;
+        }
+    }
+
+    // A tiny budget forces many runs
+    std::vector<std::string> runs;
+    ASSERT_TRUE(ExternalSort::build_runs(inputs, "./external_sort_run", 4096, runs));
+    ASSERT_TRUE(runs.size() > 1);
+
+    std::vector<std::pair<std::string, uint64_t>> merged;
+    ASSERT_TRUE(ExternalSort::merge_runs(runs, [&merged](std::string_view key, uint64_t count) {
+        merged.emplace_back(std::string(key), count);
+    }));
+    ExternalSort::remove_runs(runs);
+    ExternalSort::remove_runs(inputs);
+
+    // Every key exactly once, ascending, with the full count
+    ASSERT_EQ(expected.size(), merged.size());
+    bool same = true;
+    auto it = expected.begin();
+    for (const auto& kv : merged) {
+        same = same && kv.first == it->first && kv.second == it->second;
+        ++it;
+    }
+    ASSERT_TRUE(same);
+}
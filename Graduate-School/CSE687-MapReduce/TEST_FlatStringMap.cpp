@@ -0,0 +1,48 @@
+#include "FlatStringMap.h"
+#include "TEST_Test_Framework.h"
+#include <map>
+#include <string>
+
+TEST_CASE(FlatStringMapTests) {
+    FlatStringMap<int> counts;
+    std::map<std::string, int> reference;
+
+    // Enough distinct keys to force several rehashes
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = "w" + std::to_string(i % 5000);
+        counts[key] += i;
+        reference[key] += i;
+    }
+    ASSERT_EQ(reference.size(), counts.size());
+
+    bool same = true;
+    for (const auto& kv : reference) {
+        const int* value = counts.find(kv.first);
+        same = same && value != nullptr && *value == kv.second;
+    }
+    ASSERT_TRUE(same);
+    ASSERT_TRUE(counts.find("missing") == nullptr);
+
+    // sorted() yields std::map order
+    auto ordered = counts.sorted();
+    auto it = reference.begin();
+    bool inOrder = true;
+    for (const auto* entry : ordered) {
+        inOrder = inOrder && entry->first == it->first;
+        ++it;
+    }
+    ASSERT_TRUE(inOrder);
+
+    // merge() sums shared keys and keeps the other map's keys valid
+    FlatStringMap<int> other;
+    other["w1"] = 100;
+    {
+        std::string temporary = "only_in_other";
+        other[temporary] = 7;
+    }
+    int before = *counts.find("w1");
+    counts.merge(std::move(other));
+    ASSERT_EQ(before + 100, *counts.find("w1"));
+    ASSERT_EQ(7, *counts.find("only_in_other"));
+    ASSERT_TRUE(other.empty());
+}
@@ -0,0 +1,49 @@
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "TEST_Test_Framework.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_CASE(InputSplitTests) {
+    std::string first = "./input_split_a.txt";
+    std::string second = "./input_split_b.txt";
+    std::string empty = "./input_split_empty.txt";
+    std::string text = "alpha beta\r\ngamma\n\nsome much longer line of words\nend";
+    std::ofstream(first, std::ios::binary) << text;
+    std::ofstream(second, std::ios::binary) << "x\n";
+    std::ofstream(empty, std::ios::binary).close();
+
+    // Empty files produce no splits; the last split of a file is short
+    std::vector<InputSplit> splits;
+    ASSERT_TRUE(InputSplit::plan({first, second, empty}, 7, splits));
+    ASSERT_EQ((text.size() + 6) / 7 + 1, splits.size());
+    ASSERT_EQ(text.size() + 2, InputSplit::total_bytes(splits));
+    ASSERT_EQ(second, splits.back().path);
+
+    // Whatever the cut points, the line ranges of a file's splits tile it
+    // exactly, each piece starting at a line start
+    for (uint64_t splitBytes = 1; splitBytes <= text.size() + 1; ++splitBytes) {
+        std::vector<InputSplit> fileSplits;
+        ASSERT_TRUE(InputSplit::plan({first}, splitBytes, fileSplits));
+        MappedFile file(first);
+        std::string rebuilt;
+        for (const InputSplit& split : fileSplits) {
+            std::string_view lines = MappedFile::line_range(file.view(), split.offset, split.length);
+            if (!lines.empty() && lines.data() != file.view().data()) {
+                ASSERT_EQ('\n', lines.data()[-1]);
+            }
+            rebuilt.append(lines.data(), lines.size());
+        }
+        ASSERT_EQ(text, rebuilt);
+    }
+
+    // Split size scales with the input but stays within its bounds
+    ASSERT_EQ(InputSplit::kMinSplitBytes, InputSplit::default_split_bytes(1000, 8));
+    ASSERT_EQ(InputSplit::kMaxSplitBytes, InputSplit::default_split_bytes(1ull << 40, 8));
+    ASSERT_EQ(4ull << 20, InputSplit::default_split_bytes(256ull << 20, 8));
+
+    std::vector<InputSplit> missing;
+    ASSERT_TRUE(!InputSplit::plan({"./input_split_missing.txt"}, 7, missing));
+    ASSERT_TRUE(missing.empty());
+}
@@ -0,0 +1,102 @@
+#include "InvertedIndex.h"
+#include "MappedFile.h"
+#include "TEST_Test_Framework.h"
+#include "Tokenizer.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST_CASE(InvertedIndexTests) {
+    std::string a = "./index_test_a.txt";
+    std::string b = "./index_test_b.txt";
+    std::string empty = "./index_test_empty.txt";
+    std::string path = "./index_test.mri";
+    {
+        std::ofstream out(a);
+        for (int line = 0; line < 200; ++line) {
+            out << "The cat sat on the mat, line " << line << "\n";
+        }
+    }
+    std::ofstream(b) << "dog cat\n\nA dog's DOG\n";
+    std::ofstream(empty) << "";
+
+    // Small splits cut the first file into many, so positions must carry
+    // across split boundaries
+    InvertedIndex builder;
+    ASSERT_TRUE(builder.build({a, empty, b}, {"a.txt", "empty.txt", "b.txt"}, ".", path, 512));
+
+    // Expected postings by tokenizing every file whole
+    std::map<std::string, std::map<uint32_t, std::vector<uint32_t>>> expected;
+    std::string scratch;
+    std::vector<std::string> inputs = {a, empty, b};
+    for (uint32_t d = 0; d < inputs.size(); ++d) {
+        MappedFile file(inputs[d]);
+        uint32_t ordinal = 0;
+        Tokenizer::for_each_word(file.view(), scratch, [&expected, &ordinal, d](std::string_view word) {
+            expected[std::string(word)][d].push_back(ordinal++);
+        });
+    }
+    ASSERT_EQ(expected.size(), builder.term_count());
+
+    IndexReader reader;
+    ASSERT_TRUE(reader.open(path));
+    ASSERT_EQ(3u, reader.document_count());
+    ASSERT_EQ("empty.txt", reader.document(1));
+    ASSERT_EQ(expected.size(), reader.term_count());
+    bool matches = true;
+    for (const auto& entry : expected) {
+        PostingList postings = reader.find(entry.first);
+        matches = matches && postings.document_frequency() == entry.second.size();
+        std::map<uint32_t, std::vector<uint32_t>> found;
+        while (postings.next()) {
+            found[postings.document()] = postings.positions();
+        }
+        matches = matches && found == entry.second;
+    }
+    ASSERT_TRUE(matches);
+
+    PostingList cat = reader.find("cat");
+    ASSERT_EQ(2u, cat.document_frequency());
+    ASSERT_TRUE(cat.next());
+    ASSERT_EQ(0u, cat.document());
+    ASSERT_EQ(200u, cat.positions().size());
+    ASSERT_EQ(9u, cat.positions()[1]);
+    ASSERT_TRUE(cat.next());
+    ASSERT_EQ(2u, cat.document());
+    ASSERT_TRUE((cat.positions() == std::vector<uint32_t>{1}));
+    ASSERT_TRUE(!cat.next());
+    PostingList dog = reader.find("dog");
+    ASSERT_TRUE(dog.next());
+    ASSERT_TRUE((dog.positions() == std::vector<uint32_t>{0, 4}));
+    ASSERT_TRUE(reader.find("Cat").empty());
+    ASSERT_TRUE(reader.find("zebra").empty());
+    ASSERT_TRUE(!std::filesystem::exists("./index_spill_0.bin"));
+
+    // Truncated files and other formats are rejected on open
+    std::string truncated = "./index_test_truncated.mri";
+    {
+        MappedFile whole(path);
+        std::ofstream(truncated, std::ios::binary) << whole.view().substr(0, whole.size() - 1);
+    }
+    IndexReader broken;
+    ASSERT_TRUE(!broken.open(truncated));
+    ASSERT_TRUE(!broken.open(a));
+    ASSERT_TRUE(!builder.build({a}, {}, ".", path));
+
+    // Split ordinals carry within a document; a document past 2^32 words
+    // cannot be numbered by 32-bit positions
+    std::vector<uint64_t> firstOrdinal;
+    ASSERT_TRUE(InvertedIndex::first_ordinals({0, 0, 1, 1}, {3, 4, 5, 6}, {"x", "y"}, firstOrdinal));
+    ASSERT_TRUE((firstOrdinal == std::vector<uint64_t>{0, 3, 0, 5}));
+    ASSERT_TRUE(InvertedIndex::first_ordinals({0, 0}, {1ull << 31, 1ull << 31}, {"x"}, firstOrdinal));
+    ASSERT_TRUE(!InvertedIndex::first_ordinals({0, 0, 1}, {1ull << 31, (1ull << 31) + 1, 1}, {"x", "y"}, firstOrdinal));
+
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    std::remove(empty.c_str());
+    std::remove(path.c_str());
+    std::remove(truncated.c_str());
+}
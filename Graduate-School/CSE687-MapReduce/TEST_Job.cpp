@@ -0,0 +1,135 @@
+#include "Job.h"
+#include "Combiner.h"
+#include "Mapper.h"
+#include "TEST_Test_Framework.h"
+#include "Tokenizer.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+template <typename T>
+static bool round_trips(const T& value) {
+    std::string bytes;
+    Serializer<T>::write(bytes, value);
+    T decoded{};
+    const char* pos = bytes.data();
+    // Every strict prefix is incomplete and must not move pos
+    for (size_t cut = 0; cut < bytes.size(); ++cut) {
+        const char* p = bytes.data();
+        if (Serializer<T>::read(p, bytes.data() + cut, decoded) || p != bytes.data()) {
+            return false;
+        }
+    }
+    return Serializer<T>::read(pos, bytes.data() + bytes.size(), decoded) &&
+           pos == bytes.data() + bytes.size() && decoded == value;
+}
+
+TEST_CASE(JobTests) {
+    ASSERT_TRUE(round_trips<uint64_t>(0));
+    ASSERT_TRUE(round_trips<uint64_t>(~uint64_t(0)));
+    ASSERT_TRUE(round_trips<int32_t>(-1));
+    ASSERT_TRUE(round_trips<int64_t>(INT64_MIN));
+    ASSERT_TRUE(round_trips<double>(-2.5));
+    ASSERT_TRUE(round_trips<std::string>("key with spaces"));
+    ASSERT_TRUE((round_trips<std::pair<std::string, int64_t>>({"a", -7})));
+    ASSERT_TRUE((round_trips<std::vector<uint32_t>>({3, 1, 4, 1, 5})));
+    ASSERT_TRUE(round_trips<std::vector<std::string>>({}));
+    std::string small;
+    Serializer<int32_t>::write(small, -64);
+    ASSERT_EQ(1u, small.size());
+    ASSERT_EQ(Hasher<double>::hash(0.0), Hasher<double>::hash(-0.0));
+
+    std::string a = "./job_test_a.txt";
+    std::string b = "./job_test_b.txt";
+    std::ofstream(a) << "the cat sat\nThe dog\n";
+    std::ofstream(b) << "cat 3000000000\ndog 5\ncat 2000000000\n";
+    std::vector<InputSplit> splits;
+    ASSERT_TRUE(InputSplit::plan({a, b}, 8, splits));
+
+    // Word count matches the built-in mapper and combiner
+    JobOptions options;
+    options.partitions = 3;
+    options.combinerEntries = 2;
+    auto wordCount = make_job<std::string, uint64_t>(
+        [](std::string_view, std::string_view line, auto& emit) {
+            thread_local std::string scratch;
+            Tokenizer::for_each_word(line, scratch, [&emit](std::string_view word) { emit(std::string(word), 1); });
+        },
+        [](uint64_t& into, uint64_t&& value) { into += value; },
+        [](const std::string&, std::vector<uint64_t>&& values) { return values.front(); }, options);
+    std::vector<std::pair<std::string, uint64_t>> counts;
+    ASSERT_TRUE(wordCount.run(splits, counts));
+    std::map<std::string, uint64_t> expected;
+    Combiner combiner([&expected](const Combiner& partial) {
+        for (const auto& kv : partial) {
+            expected[std::string(kv.first)] += kv.second;
+        }
+    });
+    std::string scratch;
+    for (const std::string& path : {a, b}) {
+        MappedFile file(path);
+        Mapper::map_text(file.view(), combiner, scratch);
+    }
+    combiner.flush();
+    ASSERT_TRUE((std::map<std::string, uint64_t>(counts.begin(), counts.end()) == expected));
+
+    // Numeric aggregation: sums past the range of int, without a combiner
+    auto totals = make_job<std::string, uint64_t>(
+        [](std::string_view, std::string_view line, auto& emit) {
+            size_t space = line.find(' ');
+            if (space != std::string_view::npos) {
+                emit(std::string(line.substr(0, space)), std::stoull(std::string(line.substr(space + 1))));
+            }
+        },
+        NoCombine(),
+        [](const std::string&, std::vector<uint64_t>&& values) {
+            uint64_t sum = 0;
+            for (uint64_t value : values) {
+                sum += value;
+            }
+            return sum;
+        }, options);
+    std::vector<InputSplit> numbers;
+    ASSERT_TRUE(InputSplit::plan({b}, 8, numbers));
+    std::vector<std::pair<std::string, uint64_t>> sums;
+    ASSERT_TRUE(totals.run(numbers, sums));
+    std::map<std::string, uint64_t> summed(sums.begin(), sums.end());
+    ASSERT_EQ(5000000000ull, summed["cat"]);
+    ASSERT_EQ(5u, summed["dog"]);
+    ASSERT_EQ(2u, summed.size());
+
+    // Inverted index: word -> sorted ids of the files it occurs in
+    auto index = make_job<std::string, std::vector<uint32_t>>(
+        [&b](std::string_view path, std::string_view line, auto& emit) {
+            thread_local std::string scratch;
+            uint32_t id = path == b ? 1 : 0;
+            Tokenizer::for_each_word(line, scratch, [&emit, id](std::string_view word) {
+                emit(std::string(word), std::vector<uint32_t>{id});
+            });
+        },
+        [](std::vector<uint32_t>& into, std::vector<uint32_t>&& value) {
+            into.insert(into.end(), value.begin(), value.end());
+        },
+        [](const std::string&, std::vector<std::vector<uint32_t>>&& values) {
+            std::vector<uint32_t> ids = std::move(values.front());
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            return ids;
+        }, options);
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> postings;
+    ASSERT_TRUE(index.run(splits, postings));
+    std::map<std::string, std::vector<uint32_t>> byWord(postings.begin(), postings.end());
+    ASSERT_TRUE((byWord["cat"] == std::vector<uint32_t>{0, 1}));
+    ASSERT_TRUE((byWord["sat"] == std::vector<uint32_t>{0}));
+    ASSERT_TRUE((byWord["3000000000"] == std::vector<uint32_t>{1}));
+
+    // Shuffle files are cleaned up; a missing input fails the run
+    ASSERT_TRUE(!std::filesystem::exists("./job_0.bin"));
+    std::vector<InputSplit> missing = {InputSplit{"./job_test_missing.txt", 0, 10}};
+    ASSERT_TRUE(!totals.run(missing, sums));
+
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+}
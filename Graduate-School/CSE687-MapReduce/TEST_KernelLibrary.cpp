@@ -0,0 +1,46 @@
+#include "KernelLibrary.h"
+#include "Mapper.h"
+#include "TEST_Test_Framework.h"
+#include "WordCountKernel.cpp"
+#include <string>
+#include <vector>
+
+TEST_CASE(KernelLibraryTests) {
+    // The reference kernel is linked in here; the driver gets the same
+    // table through dlopen
+    const mr_kernel* kernel = mapreduce_kernel_v1();
+    ASSERT_EQ(static_cast<uint32_t>(MR_KERNEL_ABI_VERSION), kernel->abi_version);
+
+    std::string text = "The cat, the HAT\r\nand the bat.\n";
+    FlatStringMap<uint64_t> builtin;
+    FlatStringMap<uint64_t> viaKernel;
+    Combiner builtinCombiner([&builtin](const Combiner& partial) {
+        for (const auto& kv : partial) builtin[kv.first] += kv.second;
+    });
+    std::string scratch;
+    Mapper::map_text(text, builtinCombiner, scratch);
+    builtinCombiner.flush();
+    Combiner kernelCombiner([&viaKernel](const Combiner& partial) {
+        for (const auto& kv : partial) viaKernel[kv.first] += kv.second;
+    });
+    ASSERT_TRUE(KernelLibrary::map_text(*kernel, text, kernelCombiner));
+    kernelCombiner.flush();
+    ASSERT_EQ(builtin.size(), viaKernel.size());
+    ASSERT_EQ(3u, *viaKernel.find("the"));
+    ASSERT_EQ(1u, *viaKernel.find("hat"));
+
+    // Groups larger than one batch still reduce to one record per key
+    FlatStringMap<std::vector<uint64_t>> groups;
+    for (int i = 0; i < 500; ++i) {
+        groups["word" + std::to_string(i % 50)].push_back(static_cast<uint64_t>(i));
+    }
+    FlatStringMap<uint64_t> reduced;
+    ASSERT_TRUE(KernelLibrary::reduce_groups(*kernel, groups, reduced, 64));
+    ASSERT_EQ(50u, reduced.size());
+    ASSERT_EQ(0u + 50 + 100 + 150 + 200 + 250 + 300 + 350 + 400 + 450, *reduced.find("word0"));
+
+    // A library that cannot be loaded is reported, not fatal
+    KernelLibrary library;
+    ASSERT_TRUE(!library.load("./no_such_kernel_library.so"));
+    ASSERT_TRUE(library.get() == nullptr);
+}
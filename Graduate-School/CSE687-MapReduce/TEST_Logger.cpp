@@ -0,0 +1,56 @@
+#include "Logger.h"
+#include "TEST_Test_Framework.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE(LoggerTests) {
+    std::string path = "./logger_test.log";
+    std::remove(path.c_str());
+    Logger& logger = Logger::getInstance();
+    logger.configureLogFilePath(path);
+
+    // More messages per thread than one ring holds, so producers also
+    // exercise the wait-for-drain path
+    const int threads = 4;
+    const int perThread = 5000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&logger, t]() {
+            for (int i = 0; i < perThread; ++i) {
+                logger.log("t" + std::to_string(t) + " " + std::to_string(i));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    logger.flush();
+
+    // Every message arrives once, stamped, and in order within its thread
+    std::ifstream in(path);
+    std::string line;
+    std::vector<int> next(threads, 0);
+    int total = 0;
+    bool stamped = true;
+    bool ordered = true;
+    while (std::getline(in, line)) {
+        size_t close = line.find("] t");
+        stamped = stamped && line.size() > 22 && line[0] == '[' && close == 20;
+        if (close == std::string::npos) {
+            continue;
+        }
+        std::string body = line.substr(close + 3);
+        size_t space = body.find(' ');
+        int t = std::stoi(body.substr(0, space));
+        int i = std::stoi(body.substr(space + 1));
+        ordered = ordered && i == next[t];
+        next[t] = i + 1;
+        ++total;
+    }
+    ASSERT_TRUE(stamped);
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(threads * perThread, total);
+}
@@ -0,0 +1,38 @@
+#include "MappedFile.h"
+#include "TEST_Test_Framework.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_CASE(MappedFileTests) {
+    std::string path = "./mapped_file_test.txt";
+    std::ofstream out(path, std::ios::binary);
+    out << "<\"a.txt\", \"Hello world\">\r\n<\"a.txt\", \"Hello again\">\n<\"b.txt\", \"Last line\">";
+    out.close();
+
+    MappedFile file;
+    ASSERT_TRUE(file.open(path));
+    ASSERT_TRUE(file.is_open());
+
+    // Lines come back without their "\r\n" / "\n" terminators
+    std::vector<std::string> lines;
+    MappedFile::for_each_line(file.view(), [&lines](std::string_view line) {
+        lines.emplace_back(line);
+    });
+    ASSERT_EQ(3u, lines.size());
+    ASSERT_EQ("<\"a.txt\", \"Hello world\">", lines[0]);
+    ASSERT_EQ("<\"b.txt\", \"Last line\">", lines[2]);
+
+    // Every chunk ends on a line boundary and the chunks cover the whole file
+    std::vector<std::string_view> chunks = file.split_on_lines(4);
+    ASSERT_EQ(3u, chunks.size());
+    size_t covered = 0;
+    for (std::string_view chunk : chunks) {
+        covered += chunk.size();
+    }
+    ASSERT_EQ(file.size(), covered);
+    ASSERT_EQ('\n', chunks[0].back());
+
+    file.close();
+    ASSERT_TRUE(!file.is_open());
+}
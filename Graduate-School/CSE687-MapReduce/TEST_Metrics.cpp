@@ -0,0 +1,91 @@
+#include "Metrics.h"
+#include "ThreadPool.h"
+#include "TEST_Test_Framework.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static std::string read_all(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE(MetricsTests) {
+    Metrics& metrics = Metrics::getInstance();
+    ThreadPool pool(4);
+
+    // Disabled: nothing is recorded
+    pool.enqueueTask([]() {
+        Metrics::TaskScope task("ignored", 0);
+        Metrics::add(Metrics::RecordsIn, 5);
+    });
+    pool.wait();
+    ASSERT_TRUE(metrics.phases().empty());
+
+    metrics.set_enabled(true);
+    for (size_t t = 0; t < 16; ++t) {
+        pool.enqueueTask([t]() {
+            Metrics::TaskScope task("map", t);
+            Metrics::add(Metrics::BytesRead, 100);
+            Metrics::add(Metrics::RecordsIn, t);
+            Metrics::gauge("test_queue", t);
+            // A nested scope is folded into the outer task
+            Metrics::TaskScope inner("nested", t);
+            Metrics::add(Metrics::RecordsOut, 1);
+        });
+    }
+    pool.wait();
+    for (size_t t = 0; t < 3; ++t) {
+        pool.enqueueTask([t]() {
+            Metrics::TaskScope task("reduce", t);
+            Metrics::add(Metrics::Spills, 2);
+        });
+    }
+    pool.wait();
+    Metrics::add(Metrics::LockWaitNanos, 7);
+
+    std::vector<Metrics::PhaseSummary> phases = metrics.phases();
+    ASSERT_EQ(3u, phases.size());
+    ASSERT_EQ("map", phases[0].name);
+    ASSERT_EQ(16u, phases[0].tasks);
+    ASSERT_EQ(uint64_t(1600), phases[0].counters[Metrics::BytesRead]);
+    ASSERT_EQ(uint64_t(120), phases[0].counters[Metrics::RecordsIn]);
+    ASSERT_EQ(uint64_t(16), phases[0].counters[Metrics::RecordsOut]);
+    ASSERT_TRUE(phases[0].p50Nanos <= phases[0].p99Nanos && phases[0].p99Nanos <= phases[0].maxNanos);
+    uint64_t bucketed = 0;
+    for (uint64_t count : phases[0].histogram) {
+        bucketed += count;
+    }
+    ASSERT_EQ(uint64_t(16), bucketed);
+    ASSERT_EQ("reduce", phases[1].name);
+    ASSERT_EQ(uint64_t(6), phases[1].counters[Metrics::Spills]);
+    ASSERT_EQ("unscoped", phases[2].name);
+    ASSERT_EQ(uint64_t(7), phases[2].counters[Metrics::LockWaitNanos]);
+
+    std::vector<Metrics::GaugeSummary> gauges = metrics.gauges();
+    ASSERT_EQ(1u, gauges.size());
+    ASSERT_EQ(16u, gauges[0].samples);
+    ASSERT_EQ(uint64_t(15), gauges[0].max);
+
+    // Reports
+    std::string jsonPath = "./metrics_test.json";
+    std::string tracePath = "./metrics_trace_test.json";
+    ASSERT_TRUE(metrics.write_json(jsonPath));
+    ASSERT_TRUE(metrics.write_trace(tracePath));
+    std::string json = read_all(jsonPath);
+    ASSERT_TRUE(json.find("\"name\": \"map\", \"tasks\": 16") != std::string::npos);
+    ASSERT_TRUE(json.find("\"bytes_read\": 1600") != std::string::npos);
+    std::string trace = read_all(tracePath);
+    ASSERT_TRUE(trace.find("\"traceEvents\"") != std::string::npos);
+    ASSERT_TRUE(trace.find("\"name\": \"reduce 2\", \"cat\": \"reduce\", \"ph\": \"X\"") != std::string::npos);
+    ASSERT_TRUE(trace.find("\"ph\": \"C\"") != std::string::npos);
+    std::remove(jsonPath.c_str());
+    std::remove(tracePath.c_str());
+
+    metrics.reset();
+    ASSERT_TRUE(metrics.phases().empty());
+    metrics.set_enabled(false);
+}
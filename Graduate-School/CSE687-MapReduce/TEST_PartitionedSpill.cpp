@@ -0,0 +1,90 @@
+#include "PartitionedSpill.h"
+#include "Reducer.h"
+#include "TEST_Test_Framework.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST_CASE(PartitionedSpillTests) {
+    // The partition of a key never changes between calls
+    ASSERT_EQ(PartitionedSpill::partition_for("hello", 8), PartitionedSpill::partition_for("hello", 8));
+
+    PartitionedSpill spill(PartitionedSpill::spill_paths("./spill_test", 4));
+    ASSERT_TRUE(spill.open());
+    std::map<std::string, uint64_t> first = {{"hello", 2}, {"world", 1}, {"again", 1}};
+    std::map<std::string, uint64_t> second = {{"hello", 1}, {"test", 3}, {"big", 5000000000u}};
+    spill.spill(first);
+    spill.spill(second);
+    spill.close();
+
+    // Every key lands in exactly one spill file
+    for (size_t p = 0; p < spill.size(); ++p) {
+        std::vector<std::pair<std::string, uint64_t>> records;
+        ASSERT_TRUE(FileHandler::read_mapped_data(spill.path(p), records));
+        for (const auto& kv : records) {
+            ASSERT_EQ(PartitionedSpill::partition_for(kv.first, spill.size()), p);
+        }
+    }
+
+    Reducer reducer;
+    ASSERT_TRUE(reducer.reduce_partitions(spill.paths()));
+    const FlatStringMap<uint64_t>& reduced = reducer.get_reduced_data();
+    ASSERT_EQ(3u, *reduced.find("hello"));
+    ASSERT_EQ(3u, *reduced.find("test"));
+    ASSERT_EQ(5000000000u, *reduced.find("big"));
+    ASSERT_EQ(5u, reduced.size());
+
+    // Counts past INT_MAX read back whole
+    std::vector<std::pair<std::string, uint64_t>> big;
+    ASSERT_TRUE(FileHandler::read_mapped_data(spill.path(PartitionedSpill::partition_for("big", spill.size())), big));
+    ASSERT_TRUE(std::find(big.begin(), big.end(), std::make_pair(std::string("big"), uint64_t(5000000000u))) != big.end());
+    std::map<std::string, uint64_t> summed;
+    Reducer().reduce(big, summed);
+    ASSERT_EQ(5000000000u, summed["big"]);
+
+    // Hot-key splitting: uncombined batches where "the" is 40% of the
+    // records. Once sampled as hot it is dealt over all partitions, and the
+    // reduce still sums it to the exact total.
+    PartitionedSpill skewed(PartitionedSpill::spill_paths("./spill_hot_test", 4));
+    skewed.enable_hot_key_splitting();
+    ASSERT_EQ(4u, skewed.hot_key_fanout());
+    ASSERT_TRUE(skewed.open());
+    uint64_t theTotal = 0;
+    for (int batch = 0; batch < 400; ++batch) {
+        std::vector<std::pair<std::string, uint64_t>> records;
+        for (int i = 0; i < 500; ++i) {
+            records.emplace_back(i % 5 < 2 ? std::string("the") : "w" + std::to_string((batch * 500 + i) % 997), 1);
+            theTotal += i % 5 < 2 ? 1 : 0;
+        }
+        skewed.spill(records);
+    }
+    skewed.close();
+    std::vector<std::string> hot = skewed.hot_keys();
+    ASSERT_EQ(1u, hot.size());
+    ASSERT_EQ("the", hot.front());
+
+    size_t largest = 0;
+    size_t partitionsWithThe = 0;
+    for (size_t p = 0; p < skewed.size(); ++p) {
+        std::vector<std::pair<std::string, uint64_t>> records;
+        ASSERT_TRUE(FileHandler::read_mapped_data(skewed.path(p), records));
+        largest = std::max(largest, records.size());
+        bool hasThe = false;
+        for (const auto& kv : records) {
+            hasThe = hasThe || kv.first == "the";
+        }
+        partitionsWithThe += hasThe ? 1 : 0;
+    }
+    ASSERT_EQ(4u, partitionsWithThe);
+    ASSERT_TRUE(largest < 200000 * 35 / 100);
+
+    Reducer hotReducer;
+    ASSERT_TRUE(hotReducer.reduce_partitions(skewed.paths()));
+    ASSERT_EQ(theTotal, *hotReducer.get_reduced_data().find("the"));
+    ASSERT_EQ(998u, hotReducer.get_reduced_data().size());
+    for (const std::string& path : skewed.paths()) {
+        std::remove(path.c_str());
+    }
+}
@@ -0,0 +1,62 @@
+#include "RecordIO.h"
+#include "TEST_Test_Framework.h"
+#include <fstream>
+#include <string>
+#include <string_view>
+
+TEST_CASE(RecordIOTests) {
+    // Varints: one byte below 128, more above
+    std::string encoded;
+    RecordWriter::append_varint(encoded, 127);
+    ASSERT_EQ(1u, encoded.size());
+    RecordWriter::append_varint(encoded, 300);
+    ASSERT_EQ(3u, encoded.size());
+
+    const char* pos = encoded.data();
+    uint64_t value = 0;
+    ASSERT_TRUE(RecordReader::read_varint(pos, encoded.data() + encoded.size(), value));
+    ASSERT_EQ(127u, value);
+    ASSERT_TRUE(RecordReader::read_varint(pos, encoded.data() + encoded.size(), value));
+    ASSERT_EQ(300u, value);
+
+    // Round trip through a file with a buffer much smaller than the data,
+    // so records straddle refills
+    std::string path = "./record_io_test.bin";
+    {
+        RecordWriter writer(path, 32);
+        for (int i = 0; i < 1000; ++i) {
+            writer.write("word" + std::to_string(i), static_cast<uint64_t>(i) * 1000);
+        }
+        writer.write(std::string(100, 'x'), 1);
+    }
+
+    RecordReader reader(path, 16);
+    std::string_view key;
+    uint64_t count = 0;
+    int records = 0;
+    bool matches = true;
+    while (reader.next(key, count)) {
+        if (records < 1000) {
+            matches = matches && key == "word" + std::to_string(records) && count == static_cast<uint64_t>(records) * 1000;
+        }
+        ++records;
+    }
+    ASSERT_EQ(1001, records);
+    ASSERT_TRUE(matches);
+    ASSERT_EQ(100u, key.size());
+    ASSERT_TRUE(!reader.truncated());
+
+    // A failed write (here: a full device) is reported by flush and close
+    std::ifstream full("/dev/full");
+    if (full) {
+        RecordWriter failing;
+        ASSERT_TRUE(failing.open("/dev/full", 32));
+        for (int i = 0; i < 10000; ++i) {
+            failing.write("word" + std::to_string(i), 1);
+        }
+        ASSERT_TRUE(!failing.flush());
+        ASSERT_TRUE(!failing.close());
+    }
+    RecordWriter unopened;
+    ASSERT_TRUE(unopened.close());
+}
@@ -0,0 +1,90 @@
+#include "ResultCache.h"
+#include "TEST_Test_Framework.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::map<std::string, uint64_t> read_partials(const ResultCache& cache) {
+    std::map<std::string, uint64_t> counts;
+    for (const std::string& path : cache.partial_paths()) {
+        RecordReader reader(path);
+        std::string_view word;
+        uint64_t count;
+        while (reader.next(word, count)) {
+            counts[std::string(word)] += count;
+        }
+    }
+    return counts;
+}
+
+TEST_CASE(ResultCacheTests) {
+    std::string inputs = "./result_cache_inputs";
+    std::string folder = "./result_cache_folder";
+    fs::remove_all(inputs);
+    fs::remove_all(folder);
+    fs::create_directories(inputs);
+    std::string a = inputs + "/a.txt";
+    std::string b = inputs + "/b.txt";
+    std::string c = inputs + "/c.txt";
+    std::ofstream(a) << "the cat\nthe dog\n";
+    std::ofstream(b) << "The end.\n";
+    std::ofstream(c) << "dog\n";
+
+    // First run maps everything
+    ResultCache cache(folder);
+    ASSERT_TRUE(cache.update({a, b, c}));
+    ASSERT_EQ(0u, cache.reused_files());
+    ASSERT_EQ(3u, cache.mapped_files());
+    std::map<std::string, uint64_t> counts = read_partials(cache);
+    ASSERT_EQ(3u, counts["the"]);
+    ASSERT_EQ(2u, counts["dog"]);
+    ASSERT_EQ(1u, counts["end"]);
+    ASSERT_TRUE(cache.raw_bytes() > 0);
+
+    // A rerun over the same files, from a fresh object, maps nothing
+    ResultCache rerun(folder);
+    ASSERT_TRUE(rerun.update({a, b, c}));
+    ASSERT_EQ(3u, rerun.reused_files());
+    ASSERT_EQ(0u, rerun.mapped_files());
+    ASSERT_TRUE(counts == read_partials(rerun));
+    ASSERT_EQ(cache.raw_bytes(), rerun.raw_bytes());
+
+    // Changed contents are re-mapped; a touched but identical file is not
+    std::ofstream(c) << "cat\n";
+    fs::last_write_time(b, fs::last_write_time(b) + std::chrono::hours(1));
+    ASSERT_TRUE(rerun.update({a, b, c}));
+    ASSERT_EQ(2u, rerun.reused_files());
+    ASSERT_EQ(1u, rerun.mapped_files());
+    counts = read_partials(rerun);
+    ASSERT_EQ(1u, counts["dog"]);
+    ASSERT_EQ(2u, counts["cat"]);
+    ASSERT_TRUE(rerun.update({a, b, c}));
+    ASSERT_EQ(3u, rerun.reused_files());
+
+    // Dropped inputs lose their entries and partial files
+    ASSERT_TRUE(rerun.update({a}));
+    ASSERT_EQ(1u, rerun.reused_files());
+    counts = read_partials(rerun);
+    ASSERT_EQ(0u, counts.count("end"));
+    size_t partialFiles = 0;
+    for (const auto& file : fs::directory_iterator(folder)) {
+        partialFiles += file.path().filename().string().rfind("partial_", 0) == 0 ? 1 : 0;
+    }
+    ASSERT_EQ(rerun.partial_paths().size(), partialFiles);
+
+    // A manifest from another format version is discarded
+    std::ofstream(folder + "/manifest.txt") << "mapreduce-result-cache 0 7\n";
+    ASSERT_TRUE(rerun.update({a, b}));
+    ASSERT_EQ(2u, rerun.mapped_files());
+    ASSERT_EQ(3u, read_partials(rerun)["the"]);
+
+    ASSERT_TRUE(!rerun.update({inputs + "/missing.txt"}));
+
+    fs::remove_all(inputs);
+    fs::remove_all(folder);
+}
@@ -0,0 +1,96 @@
+#include "TaskArena.h"
+#include "Combiner.h"
+#include "StringPool.h"
+#include "TEST_Test_Framework.h"
+#include "Tokenizer.h"
+#include <map>
+#include <string>
+#include <thread>
+
+// One map task's worth of work: tokenize, combine, flush.
+static uint64_t run_task(TaskArena& arena, const std::string& text, std::map<std::string, uint64_t>& counts) {
+    Combiner combiner([&counts](const Combiner& partial) {
+        for (const auto& kv : partial) {
+            counts[std::string(kv.first)] += kv.second;
+        }
+    }, 1024, arena.resource());
+    std::pmr::string scratch(arena.resource());
+    uint64_t words = 0;
+    Tokenizer::for_each_word(text, scratch, [&combiner, &words](std::string_view word) {
+        combiner.add(word);
+        ++words;
+    });
+    combiner.flush();
+    return words;
+}
+
+TEST_CASE(TaskArenaTests) {
+    std::string text;
+    for (int i = 0; i < 3000; ++i) {
+        text += "Word" + std::to_string(i % 1500) + " the, cat\n";
+    }
+
+    // The first task on a thread overflows to the heap and sizes the
+    // thread's buffer; the next one fits in it
+    std::thread([&text]() {
+        std::map<std::string, uint64_t> counts;
+        {
+            TaskArena first;
+            ASSERT_EQ(9000u, run_task(first, text, counts));
+            ASSERT_TRUE(first.overflow_bytes() > 0);
+        }
+        size_t retained = TaskArena::retained_bytes();
+        ASSERT_TRUE(retained > 0);
+        {
+            TaskArena second;
+            run_task(second, text, counts);
+            ASSERT_EQ(0u, second.overflow_bytes());
+
+            // A second live arena on the thread does not share the buffer
+            TaskArena nested;
+            std::pmr::string word("a key longer than the small string buffer", nested.resource());
+            ASSERT_TRUE(nested.overflow_bytes() > 0);
+        }
+        ASSERT_EQ(retained, TaskArena::retained_bytes());
+        ASSERT_EQ(1502u, counts.size());
+        ASSERT_EQ(6000u, counts["the"]);
+        ASSERT_EQ(4u, counts["word7"]);
+    }).join();
+
+    // Pools on different resources can still be merged; every block goes
+    // back to the resource it came from
+    TaskArena arena;
+    StringPool taskKeys(16, arena.resource());
+    StringPool keys(16);
+    std::string_view fromTask = taskKeys.intern("task");
+    std::string_view large = taskKeys.intern("an oversized key");
+    std::string_view own = keys.intern("own");
+    keys.adopt(std::move(taskKeys));
+    ASSERT_EQ("task", fromTask);
+    ASSERT_EQ("an oversized key", large);
+    ASSERT_EQ("own", own);
+    ASSERT_EQ(23u, keys.bytes_used());
+    StringPool moved(std::move(keys));
+    ASSERT_EQ("own", own);
+    moved.clear();
+    ASSERT_EQ(0u, moved.bytes_used());
+    ASSERT_EQ("next", moved.intern("next"));
+
+    // Arena use is bounded by the table size, not by how many keys a task
+    // flushes over its lifetime
+    std::thread([]() {
+        TaskArena bounded;
+        uint64_t spilled = 0;
+        Combiner combiner([&spilled](const Combiner& partial) { spilled += partial.size(); }, 4096,
+                          bounded.resource());
+        std::string key;
+        for (int i = 0; i < 500000; ++i) {
+            key = "a_distinct_key_long_enough_to_fill_blocks_" + std::to_string(i);
+            combiner.add(key);
+        }
+        combiner.flush();
+        ASSERT_EQ(500000u, spilled);
+        ASSERT_TRUE(combiner.flush_count() > 100);
+        ASSERT_TRUE(bounded.overflow_bytes() < 1024u * 1024);
+    }).join();
+}
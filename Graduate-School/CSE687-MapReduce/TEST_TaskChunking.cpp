@@ -0,0 +1,75 @@
+#include "Mapper.h"
+#include "Metrics.h"
+#include "RecordIO.h"
+#include "TaskChunking.h"
+#include "TEST_Test_Framework.h"
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST_CASE(TaskChunkingTests) {
+    // Ranges follow bytes, not item counts: one long item fills a range alone
+    std::vector<size_t> sizes = {10, 10, 100, 10, 10, 10, 10, 10};
+    auto ranges = TaskChunking::ranges(sizes.size(), 30, [&sizes](size_t i) { return sizes[i]; });
+    ASSERT_EQ(3u, ranges.size());
+    ASSERT_EQ(size_t(0), ranges[0].first);
+    ASSERT_EQ(size_t(3), ranges[0].second);
+    ASSERT_EQ(size_t(6), ranges[1].second);
+    ASSERT_EQ(size_t(8), ranges[2].second);
+    ASSERT_TRUE(TaskChunking::ranges(0, 30, [](size_t) { return 1; }).empty());
+
+    // Several tasks per worker, never below the minimum
+    ASSERT_EQ(uint64_t(1) << 20, TaskChunking::target_bytes(64ull << 20, 8, 1 << 16));
+    ASSERT_EQ(uint64_t(1) << 16, TaskChunking::target_bytes(1000, 8, 1 << 16));
+
+    // One split covering a whole file: idle workers make the running task
+    // hand off parts of its range, and every word is still counted once
+    std::string path = "./task_chunking_test.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        for (int i = 0; i < 400000; ++i) {
+            out << "alpha beta w" << (i % 1000) << "\n";
+        }
+    }
+    std::vector<InputSplit> splits;
+    ASSERT_TRUE(InputSplit::plan({path}, 1ull << 30, splits));
+    ASSERT_EQ(1u, splits.size());
+
+    ThreadPool pool(4);
+    Metrics& metrics = Metrics::getInstance();
+    metrics.set_enabled(true);
+    std::vector<std::string> spillPaths = PartitionedSpill::spill_paths("./task_chunking_spill", 2);
+    PartitionedSpill spill(spillPaths);
+    Mapper mapper(pool);
+    ASSERT_TRUE(mapper.map_splits(splits, spill));
+    std::vector<Metrics::PhaseSummary> phases = metrics.phases();
+    ASSERT_TRUE(!phases.empty() && phases[0].name == "map" && phases[0].tasks > 1);
+    metrics.reset();
+    metrics.set_enabled(false);
+
+    std::map<std::string, uint64_t> counts;
+    for (const std::string& spillPath : spillPaths) {
+        RecordReader reader(spillPath);
+        std::string_view key;
+        uint64_t count;
+        while (reader.next(key, count)) {
+            counts[std::string(key)] += count;
+        }
+        std::remove(spillPath.c_str());
+    }
+    ASSERT_EQ(uint64_t(400000), counts["alpha"]);
+    ASSERT_EQ(uint64_t(400000), counts["beta"]);
+    ASSERT_EQ(uint64_t(400), counts["w999"]);
+    ASSERT_EQ(1002u, counts.size());
+
+    // A split whose file cannot be opened fails the map phase
+    std::vector<InputSplit> missing = {InputSplit{"./task_chunking_missing.txt", 0, 10}};
+    PartitionedSpill failing(spillPaths);
+    ASSERT_TRUE(!mapper.map_splits(missing, failing));
+    for (const std::string& spillPath : spillPaths) {
+        std::remove(spillPath.c_str());
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,33 @@
+#include "ThreadPool.h"
+#include "TEST_Test_Framework.h"
+#include <atomic>
+
+TEST_CASE(ThreadPoolTests) {
+    ThreadPool pool(4);
+    ASSERT_EQ(4u, pool.size());
+
+    // The same threads serve several phases back to back
+    for (int phase = 0; phase < 3; ++phase) {
+        std::atomic<int> counter{0};
+        for (int i = 0; i < 1000; ++i) {
+            pool.enqueueTask([&counter]() { counter++; });
+        }
+        pool.wait();
+        ASSERT_EQ(1000, counter.load());
+    }
+
+    // Tasks spawned from inside a worker are waited for as well
+    std::atomic<int> nested{0};
+    for (int i = 0; i < 10; ++i) {
+        pool.enqueueTask([&pool, &nested]() {
+            for (int j = 0; j < 10; ++j) {
+                pool.enqueueTask([&nested]() { nested++; });
+            }
+        });
+    }
+    pool.wait();
+    ASSERT_EQ(100, nested.load());
+    ASSERT_EQ(0u, pool.queuedTaskCount());
+
+    pool.shutdown();
+}
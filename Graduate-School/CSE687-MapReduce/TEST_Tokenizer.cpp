@@ -0,0 +1,58 @@
+#include "Tokenizer.h"
+#include "TEST_Test_Framework.h"
+#include <cctype>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The reference behaviour the tokenizer replaces: operator>> + clean_word
+static std::vector<std::string> reference_words(const std::string& text) {
+    std::vector<std::string> words;
+    std::istringstream ss(text);
+    std::string word;
+    while (ss >> word) {
+        std::string cleaned;
+        for (char c : word) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                cleaned += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        if (!cleaned.empty()) {
+            words.push_back(cleaned);
+        }
+    }
+    return words;
+}
+
+static std::vector<std::string> tokenizer_words(const std::string& text) {
+    std::vector<std::string> words;
+    std::string scratch;
+    Tokenizer::for_each_word(text, scratch, [&words](std::string_view word) {
+        words.emplace_back(word);
+    });
+    return words;
+}
+
+TEST_CASE(TokenizerTests) {
+    std::vector<std::string> words = tokenizer_words("  Hello, World!\tIt's 2025 -- don't\r\nSTOP ");
+    std::vector<std::string> expected = {"hello", "world", "its", "2025", "dont", "stop"};
+    ASSERT_TRUE(words == expected);
+
+    // Long runs that cross block boundaries in every vector width
+    std::string longWord(100, 'A');
+    ASSERT_EQ(std::string(100, 'a'), tokenizer_words(longWord + " ")[0]);
+
+    // Random bytes, including >= 0x80 and every whitespace character
+    std::mt19937 rng(687);
+    const std::string alphabet = "abcXYZ019 \t\n\v\f\r.,'-!\x80\xe9\xff";
+    bool allMatch = true;
+    for (int round = 0; round < 2000; ++round) {
+        std::string text(rng() % 200, ' ');
+        for (char& c : text) {
+            c = alphabet[rng() % alphabet.size()];
+        }
+        allMatch = allMatch && (tokenizer_words(text) == reference_words(text));
+    }
+    ASSERT_TRUE(allMatch);
+}
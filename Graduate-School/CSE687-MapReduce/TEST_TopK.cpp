@@ -0,0 +1,92 @@
+#include "CountMinSketch.h"
+#include "SpaceSaving.h"
+#include "TopK.h"
+#include "TEST_Test_Framework.h"
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE(TopKTests) {
+    // Zipf-like stream fed in batches through summaries much smaller than
+    // the vocabulary
+    std::mt19937 rng(11);
+    std::map<std::string, uint64_t> truth;
+    SpaceSaving left(64);
+    SpaceSaving right(64);
+    CountMinSketch sketch(4, 1024);
+    uint64_t total = 0;
+    for (int batch = 0; batch < 40; ++batch) {
+        std::map<std::string, uint64_t> counts;
+        for (int i = 0; i < 500; ++i) {
+            int rank = 1 + static_cast<int>(rng() % 2000);
+            int word = (rank % 7 == 0) ? rank : rank % 20;
+            counts["w" + std::to_string(word)]++;
+        }
+        for (const auto& kv : counts) {
+            truth[kv.first] += kv.second;
+            sketch.add(kv.first, kv.second);
+            total += kv.second;
+        }
+        (batch % 2 ? left : right).add_exact(counts);
+    }
+    left.merge(right);
+    ASSERT_TRUE(left.get_counters().size() <= 64u);
+
+    // Every counter brackets the true count, slack stays within N / m, and
+    // untracked keys are below the untracked bound
+    bool bracketed = true;
+    bool slackBounded = true;
+    for (const auto& counter : left.get_counters()) {
+        uint64_t actual = truth[counter.key];
+        bracketed = bracketed && counter.count >= actual && counter.count - counter.error <= actual;
+        slackBounded = slackBounded && counter.error <= 2 * total / 64;
+    }
+    ASSERT_TRUE(bracketed);
+    ASSERT_TRUE(slackBounded);
+    bool untrackedBounded = true;
+    bool sketchAbove = true;
+    for (const auto& kv : truth) {
+        bool tracked = false;
+        for (const auto& counter : left.get_counters()) {
+            tracked = tracked || counter.key == kv.first;
+        }
+        untrackedBounded = untrackedBounded && (tracked || kv.second <= left.untracked_bound());
+        sketchAbove = sketchAbove && sketch.estimate(kv.first) >= kv.second;
+    }
+    ASSERT_TRUE(untrackedBounded);
+    ASSERT_TRUE(sketchAbove);
+
+    // The heavy words are the top of the summary
+    std::vector<SpaceSaving::Counter> top = left.top(5);
+    ASSERT_EQ(5u, top.size());
+    ASSERT_TRUE(top[0].count >= top[4].count);
+
+    // Job mode over real files: exact mode reproduces exact counts
+    std::string path = "./top_k_test.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        for (int i = 0; i < 3000; ++i) {
+            out << "the " << (i % 3 == 0 ? "cat " : "dog ") << "w" << i << "\n";
+        }
+    }
+    std::vector<InputSplit> splits;
+    ASSERT_TRUE(InputSplit::plan({path}, 4096, splits));
+    TopK::Options options;
+    options.k = 3;
+    options.capacity = 16;
+    options.exact = true;
+    TopK topK(options);
+    std::vector<TopK::Result> ranked;
+    ASSERT_TRUE(topK.run(splits, ranked));
+    ASSERT_EQ(3u, ranked.size());
+    ASSERT_EQ("the", ranked[0].key);
+    ASSERT_EQ(uint64_t(3000), ranked[0].count);
+    ASSERT_EQ("dog", ranked[1].key);
+    ASSERT_EQ(uint64_t(2000), ranked[1].count);
+    ASSERT_EQ(uint64_t(1000), ranked[2].count);
+    ASSERT_TRUE(topK.complete());
+    std::remove(path.c_str());
+}
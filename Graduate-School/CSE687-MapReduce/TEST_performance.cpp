@@ -1,37 +1,482 @@
-#include <iostream>
+// Throughput benchmark for the map, shuffle and reduce phases.
+//
+// Generates a synthetic corpus with a Zipfian word distribution, then runs
+// each phase over it with warmups and repetitions and reports MB/s,
+// records/s, p50/p99 task latency and peak RSS, on stdout and as JSON:
+//
+//     ./MapReduceBenchmark --bytes=256M --vocabulary=200000 --zipf=1.1
+//         --repetitions=5 --json=bench.json --label=$(git rev-parse --short HEAD)
+//
+// Phases drive the same per-task code the job uses, one pool task per split
+// (map, shuffle) or per partition (reduce), so every task can be timed:
+//
+//     map      tokenize + combine each split (Mapper::map_text); partial
+//              counts are dropped
+//     shuffle  partition, encode and write the combined partial counts of
+//              each split (PartitionedSpill::spill)
+//     reduce   stream each spill file into a table (as Reducer does)
+//
+// Peak RSS is the process high-water mark when the phase finishes, so it
+// never decreases from one phase to the next.
+#include <algorithm>
 #include <chrono>
-#include "mapper.h"
-#include "reducer.h"
-
-int main() {
-    // Example input data
-    std::vector<std::string> lines = {
-        "This is a test",
-        "Another test line",
-        "And yet another line of text"
-    };
-
-    Mapper mapper;
-    Reducer reducer;
-
-    // Measure mapping time
-    auto start = std::chrono::high_resolution_clock::now();
-    mapper.map_words(lines, "./temp");
-    auto end = std::chrono::high_resolution_clock::now();
-    std::cout << "Mapping Time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
-
-    // Simulate mapped data for reducing
-    std::vector<std::pair<std::string, int>> mappedData = {
-        {"this", 1}, {"is", 1}, {"a", 1}, {"test", 1},
-        {"another", 1}, {"test", 1}, {"line", 1},
-        {"and", 1}, {"yet", 1}, {"another", 1}, {"line", 1}, {"of", 1}, {"text", 1}
-    };
-
-    // Measure reducing time
-    start = std::chrono::high_resolution_clock::now();
-    reducer.reduce(mappedData);
-    end = std::chrono::high_resolution_clock::now();
-    std::cout << "Reducing Time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "BlockCodec.h"
+#include "Combiner.h"
+#include "FlatStringMap.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Mapper.h"
+#include "PartitionedSpill.h"
+#include "RecordIO.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+struct BenchConfig {
+    uint64_t corpusBytes = 64ull << 20;
+    size_t vocabulary = 100000;
+    double zipf = 1.0;
+    size_t files = 8;
+    size_t reducers = 8;
+    int warmups = 1;
+    int repetitions = 5;
+    uint64_t seed = 42;
+    BlockCodec::Codec codec = BlockCodec::Codec::None;
+    std::string workDir = "./benchmark_tmp";
+    std::string jsonPath = "benchmark.json";
+    std::string label;
+    bool keep = false;
+};
 
+struct PhaseResult {
+    std::string name;
+    std::vector<double> seconds;        // one per measured repetition
+    std::vector<double> taskMillis;     // every task of every measured repetition
+    uint64_t bytes = 0;                 // per repetition
+    uint64_t records = 0;               // per repetition
+    uint64_t peakRssBytes = 0;
+};
+
+static uint64_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+    }
     return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Nearest-rank percentile of an unsorted sample.
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+// Accepts a plain number or one with a K/M/G suffix (powers of 1024).
+static bool parse_size(const std::string& text, uint64_t& value) {
+    char* end = nullptr;
+    double number = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || number < 0) {
+        return false;
+    }
+    uint64_t scale = 1;
+    if (*end == 'K' || *end == 'k') {
+        scale = 1ull << 10;
+        ++end;
+    } else if (*end == 'M' || *end == 'm') {
+        scale = 1ull << 20;
+        ++end;
+    } else if (*end == 'G' || *end == 'g') {
+        scale = 1ull << 30;
+        ++end;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    value = static_cast<uint64_t>(number * scale);
+    return true;
+}
+
+static bool parse_args(int argc, char* argv[], BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+        uint64_t number = 0;
+        bool ok = true;
+        if (key == "--bytes") {
+            ok = parse_size(value, config.corpusBytes);
+        } else if (key == "--vocabulary") {
+            ok = parse_size(value, number) && number > 0;
+            config.vocabulary = static_cast<size_t>(number);
+        } else if (key == "--zipf") {
+            config.zipf = std::strtod(value.c_str(), nullptr);
+            ok = config.zipf >= 0;
+        } else if (key == "--files") {
+            ok = parse_size(value, number) && number > 0;
+            config.files = static_cast<size_t>(number);
+        } else if (key == "--reducers") {
+            ok = parse_size(value, number) && number > 0;
+            config.reducers = static_cast<size_t>(number);
+        } else if (key == "--warmups") {
+            config.warmups = std::atoi(value.c_str());
+        } else if (key == "--repetitions") {
+            config.repetitions = std::atoi(value.c_str());
+            ok = config.repetitions > 0;
+        } else if (key == "--seed") {
+            ok = parse_size(value, config.seed);
+        } else if (key == "--codec") {
+            ok = BlockCodec::parse(value, config.codec);
+        } else if (key == "--dir") {
+            config.workDir = value;
+        } else if (key == "--json") {
+            config.jsonPath = value;
+        } else if (key == "--label") {
+            config.label = value;
+        } else if (key == "--keep") {
+            config.keep = true;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Bad argument: " << arg << "\n"
+                      << "Usage: " << argv[0] << " [--bytes=64M] [--vocabulary=100000] [--zipf=1.0] [--files=8]"
+                      << " [--reducers=8] [--warmups=1] [--repetitions=5] [--seed=42] [--codec=none|lz4]"
+                      << " [--dir=./benchmark_tmp] [--json=benchmark.json] [--label=<text>] [--keep]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Word for a vocabulary rank: the rank in base 26 letters, padded with a few
+// digits so lengths spread over 3-9 characters. Letters then digits keeps
+// every word distinct, and the tokenizer leaves both untouched.
+static std::string vocabulary_word(size_t rank) {
+    std::string word;
+    size_t n = rank;
+    do {
+        word += static_cast<char>('a' + n % 26);
+        n /= 26;
+    } while (n > 0);
+    size_t target = 3 + static_cast<size_t>(Hash::mix(rank) % 7);
+    for (size_t i = 0; word.size() < target; ++i) {
+        word += static_cast<char>('0' + (rank + i) % 10);
+    }
+    return word;
+}
+
+// Writes config.files files of Zipf(s)-distributed words, 12 per line, with
+// some capitals and punctuation so the tokenizer's slow paths run too. Files
+// stay within bytes / files so the splits come out even. Returns the number
+// of words written.
+static uint64_t generate_corpus(const BenchConfig& config, std::vector<std::string>& paths) {
+    std::vector<std::string> words(config.vocabulary);
+    std::vector<double> cdf(config.vocabulary);
+    double total = 0.0;
+    for (size_t r = 0; r < config.vocabulary; ++r) {
+        words[r] = vocabulary_word(r);
+        total += 1.0 / std::pow(static_cast<double>(r + 1), config.zipf);
+        cdf[r] = total;
+    }
+
+    std::mt19937_64 rng(config.seed);
+    std::uniform_real_distribution<double> uniform(0.0, total);
+    uint64_t wordCount = 0;
+    uint64_t perFile = config.corpusBytes / config.files;
+    std::string line;
+    for (size_t f = 0; f < config.files; ++f) {
+        std::string path = (fs::path(config.workDir) / ("corpus_" + std::to_string(f) + ".txt")).string();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        uint64_t written = 0;
+        while (written < perFile) {
+            line.clear();
+            for (int w = 0; w < 12; ++w) {
+                size_t rank = static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+                const std::string& word = words[std::min(rank, config.vocabulary - 1)];
+                uint64_t style = rng();
+                if (w > 0) {
+                    line += ' ';
+                }
+                if (w == 0 && style % 4 == 0) {
+                    line += static_cast<char>(word[0] - 'a' + 'A');
+                    line.append(word, 1, std::string::npos);
+                } else {
+                    line += word;
+                }
+                if (style % 16 == 1) {
+                    line += ',';
+                }
+            }
+            line += ".\n";
+            if (written + line.size() > perFile && written > 0) {
+                break;
+            }
+            out.write(line.data(), static_cast<std::streamsize>(line.size()));
+            written += line.size();
+            wordCount += 12;
+        }
+        paths.push_back(path);
+    }
+    return wordCount;
+}
+
+// Runs one repetition of a phase: task(i) for i in [0, tasks) on the pool.
+// Returns wall seconds and appends each task's latency in milliseconds.
+template <typename Task>
+static double run_tasks(ThreadPool& pool, size_t tasks, Task&& task, std::vector<double>* taskMillis) {
+    std::vector<double> millis(tasks, 0.0);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.enqueueTask([&task, &millis, i]() {
+            auto taskStart = std::chrono::steady_clock::now();
+            task(i);
+            millis[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - taskStart).count();
+        });
+    }
+    pool.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (taskMillis != nullptr) {
+        taskMillis->insert(taskMillis->end(), millis.begin(), millis.end());
+    }
+    return seconds;
+}
+
+template <typename Task>
+static PhaseResult measure(const BenchConfig& config, ThreadPool& pool, const std::string& name, size_t tasks,
+                           uint64_t bytes, uint64_t records, Task&& task) {
+    PhaseResult result;
+    result.name = name;
+    result.bytes = bytes;
+    result.records = records;
+    for (int i = 0; i < config.warmups; ++i) {
+        run_tasks(pool, tasks, task, nullptr);
+    }
+    for (int i = 0; i < config.repetitions; ++i) {
+        result.seconds.push_back(run_tasks(pool, tasks, task, &result.taskMillis));
+    }
+    result.peakRssBytes = peak_rss_bytes();
+    return result;
+}
+
+static double median_seconds(const PhaseResult& phase) {
+    return percentile(phase.seconds, 50.0);
+}
+
+static std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static bool write_json(const BenchConfig& config, size_t threads, uint64_t corpusWords,
+                       const std::vector<PhaseResult>& phases) {
+    std::ofstream out(config.jsonPath, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Could not open " << config.jsonPath << " for writing.\n";
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"label\": \"" << json_escape(config.label) << "\",\n";
+    out << "  \"config\": {\"bytes\": " << config.corpusBytes << ", \"words\": " << corpusWords
+        << ", \"vocabulary\": " << config.vocabulary << ", \"zipf\": " << config.zipf
+        << ", \"files\": " << config.files << ", \"reducers\": " << config.reducers
+        << ", \"warmups\": " << config.warmups << ", \"repetitions\": " << config.repetitions
+        << ", \"seed\": " << config.seed << ", \"codec\": \"" << BlockCodec::name(config.codec)
+        << "\", \"threads\": " << threads << ", \"tokenizer\": \"" << Tokenizer::implementation() << "\"},\n";
+    out << "  \"phases\": [\n";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const PhaseResult& phase = phases[i];
+        double seconds = median_seconds(phase);
+        out << "    {\"name\": \"" << phase.name << "\", \"bytes\": " << phase.bytes
+            << ", \"records\": " << phase.records << ", \"seconds\": [";
+        for (size_t r = 0; r < phase.seconds.size(); ++r) {
+            out << (r > 0 ? ", " : "") << phase.seconds[r];
+        }
+        out << "], \"median_seconds\": " << seconds
+            << ", \"mb_per_s\": " << (seconds > 0 ? phase.bytes / 1048576.0 / seconds : 0.0)
+            << ", \"records_per_s\": " << (seconds > 0 ? phase.records / seconds : 0.0)
+            << ", \"tasks\": " << phase.taskMillis.size() / phase.seconds.size()
+            << ", \"task_p50_ms\": " << percentile(phase.taskMillis, 50.0)
+            << ", \"task_p99_ms\": " << percentile(phase.taskMillis, 99.0)
+            << ", \"peak_rss_bytes\": " << phase.peakRssBytes << "}" << (i + 1 < phases.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+static void print_table(const std::vector<PhaseResult>& phases) {
+    std::cout << std::left << std::setw(9) << "phase" << std::right << std::setw(11) << "MB/s" << std::setw(14)
+              << "records/s" << std::setw(8) << "tasks" << std::setw(11) << "p50 ms" << std::setw(11) << "p99 ms"
+              << std::setw(13) << "peak RSS MB" << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+    for (const PhaseResult& phase : phases) {
+        double seconds = median_seconds(phase);
+        std::cout << std::left << std::setw(9) << phase.name << std::right << std::setw(11)
+                  << (seconds > 0 ? phase.bytes / 1048576.0 / seconds : 0.0) << std::setw(14) << std::setprecision(0)
+                  << (seconds > 0 ? phase.records / seconds : 0.0) << std::setw(8)
+                  << phase.taskMillis.size() / phase.seconds.size() << std::setprecision(2) << std::setw(11)
+                  << percentile(phase.taskMillis, 50.0) << std::setw(11) << percentile(phase.taskMillis, 99.0)
+                  << std::setprecision(1) << std::setw(13) << phase.peakRssBytes / 1048576.0 << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+    std::error_code error;
+    fs::create_directories(config.workDir, error);
+    if (error) {
+        std::cerr << "Could not create " << config.workDir << ": " << error.message() << "\n";
+        return 1;
+    }
+    RecordWriter::set_default_codec(config.codec);
+    ThreadPool& pool = ThreadPool::getInstance();
+
+    std::vector<std::string> paths;
+    uint64_t corpusWords = generate_corpus(config, paths);
+    std::vector<InputSplit> splits;
+    if (!InputSplit::plan(paths, InputSplit::default_split_bytes(config.corpusBytes, pool.size()), splits)) {
+        return 1;
+    }
+    uint64_t corpusBytes = InputSplit::total_bytes(splits);
+    std::cout << "Corpus: " << corpusBytes << " bytes, " << corpusWords << " words, " << config.vocabulary
+              << " vocabulary, zipf " << config.zipf << ", " << splits.size() << " splits, " << pool.size()
+              << " threads\n";
+
+    std::vector<PhaseResult> phases;
+
+    phases.push_back(measure(config, pool, "map", splits.size(), corpusBytes, corpusWords, [&splits](size_t t) {
+        MappedFile file;
+        if (!file.open(splits[t].path)) {
+            return;
+        }
+        Combiner combiner([](const Combiner&) {});
+        std::string scratch;
+        Mapper::map_text(MappedFile::line_range(file.view(), splits[t].offset, splits[t].length), combiner, scratch);
+        combiner.flush();
+    }));
+
+    // Combined partial counts of every split, as a map task would spill them
+    std::vector<std::vector<std::pair<std::string, uint64_t>>> partials(splits.size());
+    run_tasks(pool, splits.size(), [&splits, &partials](size_t t) {
+        MappedFile file;
+        if (!file.open(splits[t].path)) {
+            return;
+        }
+        Combiner combiner([&partials, t](const Combiner& partial) {
+            for (const auto& kv : partial) {
+                partials[t].emplace_back(std::string(kv.first), kv.second);
+            }
+        });
+        std::string scratch;
+        Mapper::map_text(MappedFile::line_range(file.view(), splits[t].offset, splits[t].length), combiner, scratch);
+        combiner.flush();
+    }, nullptr);
+    uint64_t spillRecords = 0;
+    uint64_t spillBytes = 0;
+    for (const auto& partial : partials) {
+        spillRecords += partial.size();
+        for (const auto& kv : partial) {
+            std::string record;
+            RecordWriter::append_record(record, kv.first, kv.second);
+            spillBytes += record.size();
+        }
+    }
+
+    std::vector<std::string> spillPaths =
+        PartitionedSpill::spill_paths((fs::path(config.workDir) / "spill").string(), config.reducers);
+    PartitionedSpill spill(spillPaths, config.codec);
+    PhaseResult shuffle;
+    {
+        // Every repetition rewrites the spill files from scratch
+        auto task = [&partials, &spill](size_t t) { spill.spill(partials[t]); };
+        for (int i = 0; i < config.warmups + config.repetitions; ++i) {
+            if (!spill.open()) {
+                return 1;
+            }
+            double seconds = run_tasks(pool, splits.size(), task, i < config.warmups ? nullptr : &shuffle.taskMillis);
+            if (!spill.close()) {
+                return 1;
+            }
+            if (i >= config.warmups) {
+                shuffle.seconds.push_back(seconds);
+            }
+        }
+        shuffle.name = "shuffle";
+        shuffle.bytes = spillBytes;
+        shuffle.records = spillRecords;
+        shuffle.peakRssBytes = peak_rss_bytes();
+    }
+    phases.push_back(shuffle);
+
+    phases.push_back(measure(config, pool, "reduce", spillPaths.size(), spillBytes, spillRecords, [&spillPaths](size_t p) {
+        RecordReader reader;
+        if (!reader.open(spillPaths[p])) {
+            return;
+        }
+        FlatStringMap<uint64_t> table;
+        std::string_view word;
+        uint64_t count;
+        while (reader.next(word, count)) {
+            table[word] += count;
+        }
+    }));
+
+    print_table(phases);
+    bool written = write_json(config, pool.size(), corpusWords, phases);
+    if (written) {
+        std::cout << "Results written to " << config.jsonPath << "\n";
+    }
+    if (!config.keep) {
+        fs::remove_all(config.workDir, error);
+    }
+    return written ? 0 : 1;
 }
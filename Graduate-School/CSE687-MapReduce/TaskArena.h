@@ -0,0 +1,109 @@
+#pragma once
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <cstddef>
+
+// Per-task monotonic arena for a map task's temporaries: its Combiner table
+// and the tokenizer's scratch buffer. Allocation is a pointer bump, frees
+// are no-ops, and everything goes at once when the TaskArena is destroyed,
+// so a task never returns memory block by block and workers do not contend
+// on the global allocator for it. The Combiner's key bytes are not kept
+// here: they are freed and refilled on every flush, which a monotonic arena
+// would never reclaim.
+//
+// The arena starts in a buffer owned by the worker thread and reused by
+// every task that thread runs. When a task outgrows the buffer, the excess
+// comes from the heap and the buffer is grown for the next task, so after
+// the first few tasks the whole arena lives in the reused buffer and
+// releasing it is O(1). Only one arena per thread uses the buffer; an arena
+// opened while another is live on the same thread goes straight to the heap.
+//
+// Anything allocated from resource() must be gone before the TaskArena is.
+class TaskArena {
+public:
+    // Buffers are not grown past this, so one huge task does not pin its
+    // memory on the worker for the rest of the run.
+    static constexpr size_t kMaxRetainedBytes = 64 << 20;
+
+    TaskArena() {
+        Backing& backing = thread_backing();
+        if (!backing.inUse && backing.size > 0) {
+            backing.inUse = true;
+            owner = &backing;
+            arena.emplace(backing.bytes.get(), backing.size, &overflow);
+        } else {
+            if (!backing.inUse) {
+                backing.inUse = true;
+                owner = &backing;
+            }
+            arena.emplace(&overflow);
+        }
+    }
+
+    ~TaskArena() {
+        arena.reset();
+        if (owner == nullptr) {
+            return;
+        }
+        if (overflow.allocated > 0 && owner->size < kMaxRetainedBytes) {
+            size_t grown = owner->size + overflow.allocated;
+            owner->size = grown < kMaxRetainedBytes ? grown : kMaxRetainedBytes;
+            owner->bytes.reset(new std::byte[owner->size]);
+        }
+        owner->inUse = false;
+    }
+
+    TaskArena(const TaskArena&) = delete;
+    TaskArena& operator=(const TaskArena&) = delete;
+
+    std::pmr::memory_resource* resource() {
+        return &*arena;
+    }
+
+    // Bytes this arena took from the heap beyond the thread's buffer.
+    size_t overflow_bytes() const {
+        return overflow.allocated;
+    }
+
+    // Size of the calling thread's reusable buffer.
+    static size_t retained_bytes() {
+        return thread_backing().size;
+    }
+
+private:
+    struct Backing {
+        std::unique_ptr<std::byte[]> bytes;
+        size_t size = 0;
+        bool inUse = false;
+    };
+
+    // Heap upstream that counts what the arena asks it for.
+    class Overflow : public std::pmr::memory_resource {
+    public:
+        size_t allocated = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            allocated += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    static Backing& thread_backing() {
+        thread_local Backing backing;
+        return backing;
+    }
+
+    Backing* owner = nullptr;
+    Overflow overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "ThreadPool.h"
+
+// Sizing of parallel work. Tasks are cut by bytes rather than by item count,
+// so a chunk of long lines is not many times the work of a chunk of short
+// ones, and every phase is over-decomposed into several tasks per worker:
+// when one task runs long, or one core is busy with something else, the
+// work-stealing pool hands the remaining tasks to the other workers instead
+// of the whole phase waiting on one oversized chunk.
+//
+// Tasks that cover one large range can also split themselves at run time
+// (see should_split): when a worker goes idle while a task still has a lot
+// left, the task gives away the back half of its remainder.
+class TaskChunking {
+public:
+    static constexpr size_t kTasksPerWorker = 8;
+
+    // Bytes per task for totalBytes of work spread over workers threads,
+    // never below minBytes.
+    static uint64_t target_bytes(uint64_t totalBytes, size_t workers, uint64_t minBytes) {
+        uint64_t target = totalBytes / (static_cast<uint64_t>(workers > 0 ? workers : 1) * kTasksPerWorker);
+        return target > minBytes ? target : minBytes;
+    }
+
+    // Cuts items [0, count) into consecutive [begin, end) ranges of about
+    // targetBytes each; weight(i) is the size of item i in bytes.
+    template <typename Weight>
+    static std::vector<std::pair<size_t, size_t>> ranges(size_t count, uint64_t targetBytes, Weight&& weight) {
+        std::vector<std::pair<size_t, size_t>> result;
+        size_t begin = 0;
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bytes += weight(i);
+            if (bytes >= targetBytes) {
+                result.emplace_back(begin, i + 1);
+                begin = i + 1;
+                bytes = 0;
+            }
+        }
+        if (begin < count) {
+            result.emplace_back(begin, count);
+        }
+        return result;
+    }
+
+    // True when a running task with remainingBytes still to do should hand
+    // half of it to another task: some worker is parked, there is nothing
+    // queued for it to steal, and both halves would be at least minBytes.
+    static bool should_split(const ThreadPool& pool, uint64_t remainingBytes, uint64_t minBytes) {
+        return remainingBytes >= 2 * minBytes && pool.idleWorkerCount() > 0 && pool.queuedTaskCount() == 0;
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <string>
+#include "ERROR_Handler.h"
+
+// Work-stealing scheduler shared by the map and reduce phases.
+//
+// Every worker owns a deque: it pushes and pops its own work at the back
+// (LIFO, cache-warm) while idle workers steal from the front of the other
+// deques (FIFO, oldest and usually largest work first). Workers with nothing
+// to run or steal park on a condition variable until new work arrives.
+//
+// The pool outlives a single phase: wait() blocks until every submitted task
+// has finished but leaves the threads running, so one set of threads serves
+// map, reduce and any later job. shutdown() is only needed to stop the pool
+// early; the destructor calls it.
+class ThreadPool {
+public:
+    static ThreadPool& getInstance() {
+        static ThreadPool instance(defaultThreadCount());
+        return instance;
+    }
+
+    explicit ThreadPool(size_t numThreads = defaultThreadCount())
+        : stopFlag(false), queuedTasks(0), pendingTasks(0), idleWorkers(0), nextQueue(0) {
+        if (numThreads == 0) {
+            numThreads = 1;
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            queues.emplace_back(std::make_unique<WorkQueue>());
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        shutdown();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Tasks submitted from a worker go onto that worker's own deque; tasks
+    // from outside the pool are spread round-robin over all deques.
+    void enqueueTask(std::function<void()> task) {
+        size_t index;
+        if (currentPool == this) {
+            index = currentIndex;
+        } else {
+            index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        }
+
+        pendingTasks.fetch_add(1);
+        queuedTasks.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+
+        // Only touch the parking lock when somebody is actually asleep
+        if (idleWorkers.load() > 0) {
+            { std::lock_guard<std::mutex> lock(parkMutex); }
+            parkCondition.notify_one();
+        }
+    }
+
+    // Blocks until every task submitted so far, including tasks those tasks
+    // spawned, has completed. Must not be called from a pool worker.
+    void wait() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [this]() { return pendingTasks.load() == 0; });
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            if (stopFlag) {
+                return;
+            }
+            stopFlag = true;
+        }
+        parkCondition.notify_all();
+        for (std::thread& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    // Tasks waiting in the deques (not counting tasks that are running).
+    size_t queuedTaskCount() const {
+        return queuedTasks.load(std::memory_order_relaxed);
+    }
+
+    // Workers parked for lack of work.
+    size_t idleWorkerCount() const {
+        return idleWorkers.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    static size_t defaultThreadCount() {
+        size_t hw = std::thread::hardware_concurrency();
+        return hw > 2 ? hw : 2;
+    }
+
+    bool popLocal(size_t index, std::function<void()>& task) {
+        WorkQueue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, std::function<void()>& task) {
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue& victim = *queues[(thief + offset) % queues.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || victim.tasks.empty()) {
+                continue;
+            }
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void runTask(std::function<void()>& task) {
+        queuedTasks.fetch_sub(1);
+        try {
+            task();
+        } catch (const std::exception& e) {
+            ErrorHandler::reportError(std::string("Task threw an exception: ") + e.what());
+        } catch (...) {
+            ErrorHandler::reportError("Task threw an unknown exception.");
+        }
+        task = nullptr;
+        if (pendingTasks.fetch_sub(1) == 1) {
+            { std::lock_guard<std::mutex> lock(doneMutex); }
+            doneCondition.notify_all();
+        }
+    }
+
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentIndex = index;
+        std::function<void()> task;
+        while (true) {
+            if (popLocal(index, task) || steal(index, task)) {
+                runTask(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(parkMutex);
+            idleWorkers.fetch_add(1);
+            parkCondition.wait(lock, [this]() {
+                return stopFlag || queuedTasks.load() > 0;
+            });
+            idleWorkers.fetch_sub(1);
+            if (stopFlag && queuedTasks.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    static inline thread_local ThreadPool* currentPool = nullptr;
+    static inline thread_local size_t currentIndex = 0;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex parkMutex;
+    std::condition_variable parkCondition;
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    bool stopFlag;
+    std::atomic<size_t> queuedTasks;
+    std::atomic<size_t> pendingTasks;
+    std::atomic<size_t> idleWorkers;
+    std::atomic<size_t> nextQueue;
+};
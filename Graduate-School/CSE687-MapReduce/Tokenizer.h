@@ -0,0 +1,224 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+// Define TOKENIZER_FORCE_SCALAR to build without the vector paths.
+#if defined(TOKENIZER_FORCE_SCALAR)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define TOKENIZER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TOKENIZER_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Word tokenizer for the map hot loop. Produces exactly the words of
+//
+//     std::istringstream ss(line); while (ss >> word) clean_word(word);
+//
+// (split on whitespace, keep only [A-Za-z0-9], lowercase, drop empty
+// results) without building a stream or a std::string per token.
+//
+// Bytes are classified a block at a time (32 with AVX2, 16 with SSE2, chosen
+// at compile time; scalar table lookup otherwise). A block yields a
+// whitespace mask, an alphanumeric mask and the block with A-Z lowered. Runs
+// of word bytes between whitespace are copied to the scratch buffer in one
+// go when they contain no punctuation, which is the common case. Tokens are
+// handed out as string_views into the scratch buffer.
+class Tokenizer {
+public:
+    static const char* implementation() {
+#if defined(TOKENIZER_AVX2)
+        return "avx2";
+#elif defined(TOKENIZER_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Calls fn(std::string_view word) for every cleaned word of text. The
+    // views point into scratch (a std::string or std::pmr::string) and stay
+    // valid until scratch is next reused.
+    template <typename Scratch, typename Fn>
+    static void for_each_word(std::string_view text, Scratch& scratch, Fn&& fn) {
+        if (scratch.size() < text.size()) {
+            scratch.resize(text.size());
+        }
+        State state{&scratch[0], 0, 0};
+        const char* data = text.data();
+        size_t size = text.size();
+        size_t pos = 0;
+
+#if defined(TOKENIZER_AVX2) || defined(TOKENIZER_SSE2)
+        alignas(32) char lowered[kBlock];
+        for (; pos + kBlock <= size; pos += kBlock) {
+            uint32_t space, keep;
+            classify_block(data + pos, lowered, space, keep);
+            process_block(lowered, space, keep, state, fn);
+        }
+#endif
+
+        for (; pos < size; ++pos) {
+            unsigned char c = static_cast<unsigned char>(data[pos]);
+            uint8_t cls = table().cls[c];
+            if (cls == kSpace) {
+                end_token(state, fn);
+            } else if (cls == kKeep) {
+                state.out[state.length++] = table().lower[c];
+            }
+        }
+        end_token(state, fn);
+    }
+
+    // Scalar version of the per-byte rule, for callers that only have one
+    // token. Same result as MapperDLLso::clean_word.
+    static size_t clean_into(std::string_view word, char* out) {
+        size_t length = 0;
+        for (unsigned char c : word) {
+            if (table().cls[c] == kKeep) {
+                out[length++] = table().lower[c];
+            }
+        }
+        return length;
+    }
+
+private:
+    enum : uint8_t { kDrop = 0, kKeep = 1, kSpace = 2 };
+
+#if defined(TOKENIZER_AVX2)
+    static constexpr size_t kBlock = 32;
+#else
+    static constexpr size_t kBlock = 16;
+#endif
+
+    struct State {
+        char* out;          // scratch buffer
+        size_t start;       // where the current token begins in out
+        size_t length;      // bytes written to out so far
+    };
+
+    struct Table {
+        uint8_t cls[256];
+        char lower[256];
+    };
+
+    static const Table& table() {
+        static const Table instance = []() {
+            Table t{};
+            for (int c = 0; c < 256; ++c) {
+                bool upper = c >= 'A' && c <= 'Z';
+                bool alnum = upper || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+                bool space = c == ' ' || (c >= '\t' && c <= '\r');
+                t.cls[c] = space ? kSpace : (alnum ? kKeep : kDrop);
+                t.lower[c] = static_cast<char>(upper ? c + ('a' - 'A') : c);
+            }
+            return t;
+        }();
+        return instance;
+    }
+
+    template <typename Fn>
+    static void end_token(State& state, Fn& fn) {
+        if (state.length > state.start) {
+            fn(std::string_view(state.out + state.start, state.length - state.start));
+        }
+        state.start = state.length;
+    }
+
+    static unsigned count_trailing_zeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+#if defined(TOKENIZER_AVX2)
+    static void classify_block(const char* src, char* lowered, uint32_t& space, uint32_t& keep) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        // Signed compares: bytes >= 0x80 are negative and fall outside every range
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+        __m256i lowerRange = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)),
+                                              _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        __m256i ctrl = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+        __m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), ctrl);
+        __m256i isKeep = _mm256_or_si256(_mm256_or_si256(upper, lowerRange), digit);
+        __m256i low = _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8('a' - 'A')));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lowered), low);
+        space = static_cast<uint32_t>(_mm256_movemask_epi8(isSpace));
+        keep = static_cast<uint32_t>(_mm256_movemask_epi8(isKeep));
+    }
+#elif defined(TOKENIZER_SSE2)
+    static void classify_block(const char* src, char* lowered, uint32_t& space, uint32_t& keep) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        // Signed compares: bytes >= 0x80 are negative and fall outside every range
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+        __m128i lowerRange = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                           _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        __m128i ctrl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                     _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), ctrl);
+        __m128i isKeep = _mm_or_si128(_mm_or_si128(upper, lowerRange), digit);
+        __m128i low = _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lowered), low);
+        space = static_cast<uint32_t>(_mm_movemask_epi8(isSpace));
+        keep = static_cast<uint32_t>(_mm_movemask_epi8(isKeep));
+    }
+#endif
+
+#if defined(TOKENIZER_AVX2) || defined(TOKENIZER_SSE2)
+    // Walks one classified block segment by segment, where a segment is a
+    // run of non-whitespace bytes. Fully alphanumeric segments are copied
+    // with one memcpy; segments with punctuation copy only their kept bytes.
+    template <typename Fn>
+    static void process_block(const char* lowered, uint32_t space, uint32_t keep, State& state, Fn& fn) {
+        constexpr uint32_t blockMask = static_cast<uint32_t>((uint64_t(1) << kBlock) - 1);
+        if (space == 0 && keep == blockMask) {
+            std::memcpy(state.out + state.length, lowered, kBlock);
+            state.length += kBlock;
+            return;
+        }
+
+        unsigned i = 0;
+        while (i < kBlock) {
+            uint32_t spaceAhead = space >> i;
+            if (spaceAhead & 1u) {
+                end_token(state, fn);
+                ++i;
+                continue;
+            }
+            unsigned end = spaceAhead ? i + count_trailing_zeros(spaceAhead) : static_cast<unsigned>(kBlock);
+            unsigned width = end - i;
+            uint32_t widthMask = width == 32 ? 0xFFFFFFFFu : ((1u << width) - 1);
+            uint32_t segmentKeep = (keep >> i) & widthMask;
+            if (segmentKeep == widthMask) {
+                std::memcpy(state.out + state.length, lowered + i, width);
+                state.length += width;
+            } else {
+                while (segmentKeep) {
+                    unsigned bit = count_trailing_zeros(segmentKeep);
+                    state.out[state.length++] = lowered[i + bit];
+                    segmentKeep &= segmentKeep - 1;
+                }
+            }
+            i = end;
+        }
+    }
+#endif
+};
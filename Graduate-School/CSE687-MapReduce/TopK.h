@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include "Combiner.h"
+#include "CountMinSketch.h"
+#include "FlatStringMap.h"
+#include "InputSplit.h"
+#include "MappedFile.h"
+#include "Mapper.h"
+#include "Metrics.h"
+#include "SpaceSaving.h"
+#include "TaskArena.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+
+// Top-K heavy-hitters job. Each map task combines its split as usual, but
+// the combiner's partial counts go into a per-task Space-Saving summary and
+// Count-Min sketch instead of a spill file. The reduce side merges the
+// task summaries, so memory is O(workers x capacity) however many distinct
+// words the input has and nothing is written to the temp folder.
+//
+// A candidate's estimate is the smaller of its Space-Saving bound and its
+// Count-Min estimate, both upper bounds. With exact set, a second pass over
+// the input counts only the candidates, and the K largest exact counts are
+// reported. Those are the true top K whenever the K-th count is above the
+// summary's untracked bound (see complete()); on flat distributions, where
+// no word stands out, they may not be.
+class TopK {
+public:
+    struct Options {
+        size_t k = 1000;
+        size_t capacity = 0;          // 0 = max(8k, 1024) counters per summary
+        bool exact = false;
+        size_t combinerEntries = Combiner::kDefaultEntries;
+    };
+
+    struct Result {
+        std::string key;
+        uint64_t count;
+    };
+
+    TopK() : TopK(Options()) {}
+
+    explicit TopK(Options options, ThreadPool& pool = ThreadPool::getInstance())
+        : options(options), threadPool(pool) {
+        if (this->options.k == 0) {
+            this->options.k = 1;
+        }
+        if (this->options.capacity < this->options.k) {
+            this->options.capacity = std::max<size_t>(this->options.k * 8, 1024);
+        }
+    }
+
+    // Fills ranked with at most k (key, count) pairs, largest count first.
+    bool run(const std::vector<InputSplit>& splits, std::vector<Result>& ranked) {
+        SpaceSaving summary(options.capacity);
+        CountMinSketch sketch;
+        std::mutex mergeMutex;
+        std::vector<char> succeeded(splits.size(), 0);
+
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([this, &splits, &summary, &sketch, &mergeMutex, &succeeded, t]() {
+                Metrics::TaskScope task("topk_map", t);
+                MappedFile file;
+                if (!file.open(splits[t].path)) {
+                    return;
+                }
+                SpaceSaving local(options.capacity);
+                CountMinSketch localSketch;
+                TaskArena arena;
+                Combiner combiner([&local, &localSketch](const Combiner& partial) {
+                    for (const auto& kv : partial) {
+                        localSketch.add(kv.first, kv.second);
+                    }
+                    local.add_exact(partial);
+                }, options.combinerEntries, arena.resource());
+                std::pmr::string scratch(arena.resource());
+                std::string_view text = MappedFile::line_range(file.view(), splits[t].offset, splits[t].length);
+                Metrics::add(Metrics::BytesRead, text.size());
+                Mapper::map_text(text, combiner, scratch);
+                combiner.flush();
+
+                std::lock_guard<std::mutex> lock(mergeMutex);
+                summary.merge(local);
+                sketch.merge(localSketch);
+                succeeded[t] = 1;
+            });
+        }
+        threadPool.wait();
+        if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end()) {
+            return false;
+        }
+
+        ranked.clear();
+        guaranteed = false;
+        if (!options.exact) {
+            for (const SpaceSaving::Counter& counter : summary.get_counters()) {
+                ranked.push_back(Result{counter.key, std::min(counter.count, sketch.estimate(counter.key))});
+            }
+        } else if (!count_exact(splits, summary.get_counters(), ranked)) {
+            return false;
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const Result& a, const Result& b) {
+            return a.count != b.count ? a.count > b.count : a.key < b.key;
+        });
+        if (ranked.size() > options.k) {
+            ranked.resize(options.k);
+        }
+        if (options.exact && !ranked.empty()) {
+            guaranteed = ranked.size() == summary.get_counters().size() ||
+                         ranked.back().count > summary.untracked_bound();
+        }
+        return true;
+    }
+
+    // True when the last exact run is provably the true top K: no word
+    // outside the candidates can have a larger count.
+    bool complete() const {
+        return guaranteed;
+    }
+
+    const Options& get_options() const {
+        return options;
+    }
+
+private:
+    // Second pass: exact counts for the candidate keys only.
+    bool count_exact(const std::vector<InputSplit>& splits, const std::vector<SpaceSaving::Counter>& candidates,
+                     std::vector<Result>& counted) {
+        std::vector<std::vector<uint64_t>> taskCounts(splits.size());
+        std::vector<char> succeeded(splits.size(), 0);
+        FlatStringMap<size_t> index(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            index[candidates[i].key] = i;
+        }
+
+        for (size_t t = 0; t < splits.size(); ++t) {
+            threadPool.enqueueTask([&splits, &index, &taskCounts, &succeeded, &candidates, t]() {
+                Metrics::TaskScope task("topk_count", t);
+                MappedFile file;
+                if (!file.open(splits[t].path)) {
+                    return;
+                }
+                std::vector<uint64_t>& counts = taskCounts[t];
+                counts.assign(candidates.size(), 0);
+                std::string scratch;
+                std::string_view text = MappedFile::line_range(file.view(), splits[t].offset, splits[t].length);
+                while (!text.empty()) {
+                    std::string_view slice = MappedFile::next_chunk(text, 1 << 20);
+                    Tokenizer::for_each_word(slice, scratch, [&index, &counts](std::string_view word) {
+                        if (const size_t* i = index.find(word)) {
+                            ++counts[*i];
+                        }
+                    });
+                    text.remove_prefix(slice.size());
+                }
+                succeeded[t] = 1;
+            });
+        }
+        threadPool.wait();
+        if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            uint64_t total = 0;
+            for (const std::vector<uint64_t>& counts : taskCounts) {
+                total += counts[i];
+            }
+            counted.push_back(Result{candidates[i].key, total});
+        }
+        return true;
+    }
+
+    Options options;
+    ThreadPool& threadPool;
+    bool guaranteed = false;
+};
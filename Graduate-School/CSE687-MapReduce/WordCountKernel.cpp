@@ -0,0 +1,85 @@
+// Reference job kernel: the built-in word count, packaged as a shared
+// library for the runtime kernel ABI in JobKernel.h.
+//
+//     g++ -std=c++17 -O2 -shared -fPIC -o libWordCountKernel.so WordCountKernel.cpp
+//
+// map_batch combines counts per slice before emitting, so the driver gets
+// one record per distinct word per flush instead of one per token.
+#include <string>
+#include <string_view>
+#include "Combiner.h"
+#include "JobKernel.h"
+#include "RecordIO.h"
+#include "Tokenizer.h"
+
+namespace {
+
+struct MapState {
+    mr_emit_fn emit = nullptr;
+    void* ctx = nullptr;
+    std::string scratch;
+    std::string encoded;
+    Combiner combiner;
+
+    MapState()
+        : combiner([this](const Combiner& partial) {
+              encoded.clear();
+              for (const auto& kv : partial) {
+                  RecordWriter::append_record(encoded, kv.first, kv.second);
+              }
+              emit(ctx, encoded.data(), encoded.size());
+          }) {}
+};
+
+int word_count_map(const char* text, size_t size, mr_emit_fn emit, void* ctx) {
+    thread_local MapState state;
+    state.emit = emit;
+    state.ctx = ctx;
+    Tokenizer::for_each_word(std::string_view(text, size), state.scratch, [](std::string_view word) {
+        state.combiner.add(word);
+    });
+    state.combiner.flush();
+    return 0;
+}
+
+int word_count_reduce(const char* groups, size_t size, mr_emit_fn emit, void* ctx) {
+    std::string encoded;
+    const char* pos = groups;
+    const char* end = groups + size;
+    while (pos < end) {
+        uint64_t keyLength;
+        uint64_t values;
+        if (!RecordReader::read_varint(pos, end, keyLength) || static_cast<uint64_t>(end - pos) < keyLength) {
+            return 1;
+        }
+        std::string_view key(pos, static_cast<size_t>(keyLength));
+        pos += keyLength;
+        if (!RecordReader::read_varint(pos, end, values)) {
+            return 1;
+        }
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < values; ++i) {
+            uint64_t value;
+            if (!RecordReader::read_varint(pos, end, value)) {
+                return 1;
+            }
+            sum += value;
+        }
+        RecordWriter::append_record(encoded, key, sum);
+    }
+    emit(ctx, encoded.data(), encoded.size());
+    return 0;
+}
+
+const mr_kernel kWordCountKernel = {
+    MR_KERNEL_ABI_VERSION,
+    "wordcount",
+    &word_count_map,
+    &word_count_reduce,
+};
+
+}
+
+extern "C" MR_KERNEL_EXPORT const mr_kernel* mapreduce_kernel_v1(void) {
+    return &kWordCountKernel;
+}
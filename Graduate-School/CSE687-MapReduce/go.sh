@@ -26,7 +26,7 @@ compile_project() {
     local output_file=$1
     local compile_flags=$2
     echo "Compiling source files into $output_file..."
-    g++ -std=c++17 $compile_flags -o "$output_file" $SOURCE_FILES -pthread
+    g++ -std=c++17 $compile_flags -o "$output_file" $SOURCE_FILES -pthread -ldl
 
     if [ $? -eq 0 ]; then
         echo "Build successful: $output_file"
@@ -43,12 +43,14 @@ echo "Starting the build process..."
 check_gpp_installed
 
 # Define source files and output targets
-SOURCE_FILES="main.cpp mapper.cpp reducer.cpp fileHandler.cpp utils.cpp"
+SOURCE_FILES="main.cpp"
 OUTPUT_BINARY="MapReduce"
 SHARED_LIBRARY="libMapReduce.so"
+KERNEL_LIBRARY="libWordCountKernel.so"
+BENCHMARK_BINARY="MapReduceBenchmark"
 
 # Clean previous builds
-clean_previous_builds "$OUTPUT_BINARY" "$SHARED_LIBRARY"
+clean_previous_builds "$OUTPUT_BINARY" "$SHARED_LIBRARY" "$KERNEL_LIBRARY" "$BENCHMARK_BINARY"
 
 # Compile shared library
 compile_project "$SHARED_LIBRARY" "-shared -fPIC"
@@ -56,4 +58,12 @@ compile_project "$SHARED_LIBRARY" "-shared -fPIC"
 # Compile executable binary
 compile_project "$OUTPUT_BINARY" ""
 
+# Compile the reference job kernel (load it with MAPREDUCE_KERNEL=./$KERNEL_LIBRARY)
+SOURCE_FILES="WordCountKernel.cpp"
+compile_project "$KERNEL_LIBRARY" "-O2 -shared -fPIC"
+
+# Compile the phase benchmark (./$BENCHMARK_BINARY --help lists its options)
+SOURCE_FILES="TEST_performance.cpp"
+compile_project "$BENCHMARK_BINARY" "-O2"
+
 echo "Build process completed successfully. You can run the program with ./$OUTPUT_BINARY or use the shared library $SHARED_LIBRARY."
\ No newline at end of file
@@ -7,19 +7,164 @@
 #include <algorithm>
 #include <cctype>
 #include <string>
+#include <cstdlib>
+#include <cstdint>
+#include "BlockCodec.h"
+#include "Coordinator.h"
+#include "CsvAggregate.h"
 #include "ERROR_Handler.h"
 #include "FileHandler.h"
+#include "InputSplit.h"
+#include "InvertedIndex.h"
+#include "KernelLibrary.h"
 #include "Logger.h"
+#include "MappedFile.h"
+#include "Metrics.h"
 #include "Mapper.h"
+#include "PartitionedSpill.h"
+#include "Pipeline.h"
 #include "Reducer.h"
+#include "ResultCache.h"
+#include "TopK.h"
 
 namespace fs = std::filesystem;
 
+// Rough in-memory cost of one spill byte once it is in a FlatStringMap
+// (entry, hash and probe slot per key on top of the key bytes).
+static constexpr uintmax_t kTableBytesPerSpillByte = 4;
+
+// Reduce tasks per pool worker on the partitioned path.
+static constexpr size_t kReducePartitionsPerWorker = 4;
+
+// Memory the reduce phase may use before switching to external merge sort.
+// Override with MAPREDUCE_REDUCE_MEMORY_MB.
+static size_t reduce_memory_budget_bytes()
+{
+    size_t megabytes = 1024;
+    if (const char *env = std::getenv("MAPREDUCE_REDUCE_MEMORY_MB"))
+    {
+        long long parsed = std::atoll(env);
+        if (parsed > 0)
+            megabytes = static_cast<size_t>(parsed);
+    }
+    return megabytes * 1024 * 1024;
+}
+
+// MAPREDUCE_PIPELINE=1 selects the pipelined map/reduce mode.
+static bool pipeline_mode_enabled()
+{
+    const char *env = std::getenv("MAPREDUCE_PIPELINE");
+    return env != nullptr && std::string(env) == "1";
+}
+
+// MAPREDUCE_INCREMENTAL=1 keeps per-file map results in the temp folder and
+// re-maps only the input files that changed since the last run.
+static bool incremental_mode_enabled()
+{
+    const char *env = std::getenv("MAPREDUCE_INCREMENTAL");
+    return env != nullptr && std::string(env) == "1";
+}
+
+// MAPREDUCE_SPILL_CODEC=none|lz4 picks the codec for intermediate files.
+static bool configure_spill_codec()
+{
+    const char *env = std::getenv("MAPREDUCE_SPILL_CODEC");
+    BlockCodec::Codec codec = BlockCodec::Codec::None;
+    if (env != nullptr && !BlockCodec::parse(env, codec))
+    {
+        ErrorHandler::reportError(std::string("Unknown MAPREDUCE_SPILL_CODEC '") + env + "'; expected none or lz4.");
+        return false;
+    }
+    RecordWriter::set_default_codec(codec);
+    return true;
+}
+
+// MAPREDUCE_KERNEL=<path> loads map/reduce kernels from a shared library
+// (see JobKernel.h) instead of using the built-in word count.
+static std::string kernel_library_path()
+{
+    const char *env = std::getenv("MAPREDUCE_KERNEL");
+    return env != nullptr ? std::string(env) : std::string();
+}
+
+// MAPREDUCE_WORKERS=<n> runs map and reduce tasks in n worker processes;
+// MAPREDUCE_PIN_WORKERS=1 also binds them to NUMA nodes.
+static size_t worker_process_count()
+{
+    const char *env = std::getenv("MAPREDUCE_WORKERS");
+    long long parsed = env != nullptr ? std::atoll(env) : 0;
+    return parsed > 0 ? static_cast<size_t>(parsed) : 0;
+}
+
+// MAPREDUCE_RESUME=1 runs the job as map and reduce tasks that are logged
+// to a manifest in the temp folder as they finish, so rerunning a job that
+// died skips the finished tasks (see JobManifest.h). Implies the
+// multi-process mode, with one worker per core unless MAPREDUCE_WORKERS says
+// otherwise.
+static bool resume_enabled()
+{
+    const char *env = std::getenv("MAPREDUCE_RESUME");
+    return env != nullptr && std::string(env) == "1";
+}
+
+// MAPREDUCE_TOP_K=<k> reports only the k most frequent words, from
+// bounded-memory sketches; MAPREDUCE_TOP_K_EXACT=1 recounts the candidates.
+static size_t top_k_requested()
+{
+    const char *env = std::getenv("MAPREDUCE_TOP_K");
+    long long parsed = env != nullptr ? std::atoll(env) : 0;
+    return parsed > 0 ? static_cast<size_t>(parsed) : 0;
+}
+
+// MAPREDUCE_CSV_GROUP_BY=<columns> aggregates the input folder's .csv files
+// instead of counting words, e.g. "Age:5,Cholesterol,Smoke" with
+// MAPREDUCE_CSV_MEASURES="Disease" (see CsvAggregate.h).
+static std::string csv_group_by()
+{
+    const char *env = std::getenv("MAPREDUCE_CSV_GROUP_BY");
+    return env != nullptr ? std::string(env) : std::string();
+}
+
+// MAPREDUCE_INVERTED_INDEX=1 writes a positional index of the input files to
+// <output>/index.mri instead of counting words (see InvertedIndex.h).
+static bool inverted_index_enabled()
+{
+    const char *env = std::getenv("MAPREDUCE_INVERTED_INDEX");
+    return env != nullptr && std::string(env) == "1";
+}
+
+// MAPREDUCE_METRICS=<file> writes per-phase task counters and timings as
+// JSON when the job ends (whichever way main returns); MAPREDUCE_TRACE=<file>
+// also exports every task as a Chrome trace.
+struct MetricsReport
+{
+    std::string json_path;
+    std::string trace_path;
+
+    MetricsReport()
+    {
+        if (const char *env = std::getenv("MAPREDUCE_METRICS"))
+            json_path = env;
+        if (const char *env = std::getenv("MAPREDUCE_TRACE"))
+            trace_path = env;
+        Metrics::getInstance().set_enabled(!json_path.empty() || !trace_path.empty());
+    }
+
+    ~MetricsReport()
+    {
+        if (!json_path.empty() && Metrics::getInstance().write_json(json_path))
+            Logger::getInstance().log("Task metrics written to " + json_path + ".");
+        if (!trace_path.empty() && Metrics::getInstance().write_trace(trace_path))
+            Logger::getInstance().log("Task trace written to " + trace_path + ".");
+    }
+};
+
 int main()
 { 
     // Initialize logging
     Logger::getInstance().configureLogFilePath("application.log");
     Logger::getInstance().log("WELCOME TO MAPREDUCE...");
+    MetricsReport metrics_report;
 
     // Validate Input folder
     std::string folder_path;
@@ -94,48 +239,339 @@ int main()
         return 1;
     }
 
-    // Map phase
-    std::vector<std::string> extracted_lines;
-    std::string temp_input_path = temp_folder_path + "/tempInput.txt";
-    if (!FileHandler::extract_values_from_temp_input(extracted_lines, temp_input_path))
+    // Every input file, or every fixed-size byte range of a large one, is an
+    // independent split that a worker maps and tokenizes on its own
+    std::vector<std::string> input_paths;
+    for (const std::string &file_name : file_names)
+    {
+        if (!file_name.empty())
+            input_paths.push_back((fs::path(folder_path) / file_name).string());
+    }
+    uintmax_t input_bytes = 0;
+    for (const std::string &input_path : input_paths)
     {
-        Logger::getInstance().log("ERROR: Failed to extract lines from tempInput.txt. Exiting.\n");
+        std::error_code ec;
+        uintmax_t size = fs::file_size(input_path, ec);
+        input_bytes += ec ? 0 : size;
+    }
+    std::vector<InputSplit> splits;
+    uint64_t split_bytes = InputSplit::default_split_bytes(input_bytes, ThreadPool::getInstance().size());
+    if (!InputSplit::plan(input_paths, split_bytes, splits))
+    {
+        Logger::getInstance().log("ERROR: Failed to read the input files. Exiting.\n");
         return 1;
     }
+    Logger::getInstance().log("Planned " + std::to_string(splits.size()) + " input splits over " +
+                              std::to_string(input_paths.size()) + " files.");
 
-    Mapper mapper;
-    mapper.map_words(extracted_lines, temp_folder_path);
-
-    // Reduce phase
-    std::vector<std::pair<std::string, int>> mapped_data;
-    std::string mapped_file_path = temp_folder_path + "/mapped_temp.txt";
-    if (!FileHandler::read_mapped_data(mapped_file_path, mapped_data))
+    if (!configure_spill_codec())
     {
-        Logger::getInstance().log("ERROR: Failed to read mapped data. Exiting.\n");
+        Logger::getInstance().log("ERROR: Invalid spill codec. Exiting.\n");
         return 1;
     }
+    Logger::getInstance().log(std::string("Intermediate file codec: ") + BlockCodec::name(RecordWriter::default_codec()) + ".");
 
-    Reducer reducer;
-    reducer.reduce(mapped_data);
+    // A kernel library replaces the built-in map and reduce. It runs on the
+    // partitioned in-memory path only.
+    KernelLibrary kernel_library;
+    std::string kernel_path = kernel_library_path();
+    if (!kernel_path.empty())
+    {
+        if (!kernel_library.load(kernel_path))
+        {
+            Logger::getInstance().log("ERROR: Failed to load kernel library. Exiting.\n");
+            return 1;
+        }
+        Logger::getInstance().log(std::string("Loaded kernel '") + kernel_library.get()->name + "' from " + kernel_path + ".");
+        // The pipeline and the result cache sum counts themselves, so they
+        // cannot run a kernel's reduce
+        if (pipeline_mode_enabled())
+        {
+            Logger::getInstance().log("ERROR: MAPREDUCE_PIPELINE=1 does not support MAPREDUCE_KERNEL. Exiting.\n");
+            return 1;
+        }
+        if (incremental_mode_enabled())
+        {
+            Logger::getInstance().log("ERROR: MAPREDUCE_INCREMENTAL=1 does not support MAPREDUCE_KERNEL. Exiting.\n");
+            return 1;
+        }
+    }
 
-    // Write outputs
-    std::string output_file_path = output_folder_path + "/output.txt";
-    if (!FileHandler::write_output(output_file_path, reducer.get_reduced_data()))
+    // CSV mode: group-by aggregation over the tabular inputs
+    std::string group_by = csv_group_by();
+    if (!group_by.empty())
     {
-        Logger::getInstance().log("ERROR: Failed to write output file. Exiting.\n");
-        return 1;
+        const char *measures = std::getenv("MAPREDUCE_CSV_MEASURES");
+        CsvAggregate::Spec csv_spec;
+        if (!CsvAggregate::Spec::parse(group_by, measures != nullptr ? measures : "", csv_spec))
+        {
+            Logger::getInstance().log("ERROR: Invalid CSV aggregation. Exiting.\n");
+            return 1;
+        }
+        std::vector<std::string> csv_paths;
+        for (const std::string &input_path : input_paths)
+        {
+            if (fs::path(input_path).extension() == ".csv")
+                csv_paths.push_back(input_path);
+        }
+        std::vector<InputSplit> csv_splits;
+        uintmax_t csv_bytes = 0;
+        for (const std::string &csv_path : csv_paths)
+        {
+            std::error_code ec;
+            uintmax_t size = fs::file_size(csv_path, ec);
+            csv_bytes += ec ? 0 : size;
+        }
+        if (!InputSplit::plan(csv_paths, InputSplit::default_split_bytes(csv_bytes, ThreadPool::getInstance().size()), csv_splits))
+        {
+            Logger::getInstance().log("ERROR: Failed to read the input files. Exiting.\n");
+            return 1;
+        }
+        Logger::getInstance().log("Aggregating " + std::to_string(csv_paths.size()) + " CSV files by " + group_by + ".");
+        CsvAggregate aggregate(csv_spec);
+        if (!aggregate.run(csv_splits) || !aggregate.write_csv(output_folder_path + "/output.csv"))
+        {
+            Logger::getInstance().log("ERROR: CSV aggregation failed. Exiting.\n");
+            return 1;
+        }
+
+        Logger::getInstance().log("\n Process complete!\n");
+        Logger::getInstance().log("\n  " + std::to_string(aggregate.groups().size()) + " groups: output.csv\n");
+        return 0;
+    }
+
+    // Index mode: word -> (file, positions), with files named as in the input folder
+    if (inverted_index_enabled())
+    {
+        std::vector<std::string> document_names;
+        for (const std::string &input_path : input_paths)
+            document_names.push_back(fs::path(input_path).filename().string());
+        Logger::getInstance().log("Indexing " + std::to_string(input_paths.size()) + " files.");
+        InvertedIndex index;
+        if (!index.build(input_paths, document_names, temp_folder_path, output_folder_path + "/index.mri"))
+        {
+            Logger::getInstance().log("ERROR: Index build failed. Exiting.\n");
+            return 1;
+        }
+
+        Logger::getInstance().log("\n Process complete!\n");
+        Logger::getInstance().log("\n  " + std::to_string(index.term_count()) + " words: index.mri\n");
+        return 0;
+    }
+
+    // Top-K mode: only the heaviest words are kept, in bounded memory
+    if (size_t k = top_k_requested())
+    {
+        TopK::Options top_k_options;
+        top_k_options.k = k;
+        const char *exact = std::getenv("MAPREDUCE_TOP_K_EXACT");
+        top_k_options.exact = exact != nullptr && std::string(exact) == "1";
+        Logger::getInstance().log("Running top-" + std::to_string(k) + (top_k_options.exact ? " (exact counts)." : " (estimated counts)."));
+        TopK top_k(top_k_options);
+        std::vector<TopK::Result> ranked;
+        if (!top_k.run(splits, ranked))
+        {
+            Logger::getInstance().log("ERROR: Top-K run failed. Exiting.\n");
+            return 1;
+        }
+        if (top_k_options.exact && !top_k.complete())
+            Logger::getInstance().log("WARNING: No word clearly stands out; the top-" + std::to_string(k) + " list may miss words tied near its last count.");
+        bool written = FileHandler::write_outputs_streamed(output_folder_path + "/output.txt",
+                                                           output_folder_path + "/output_summed.txt",
+            [&ranked](auto &&emit) {
+                for (const TopK::Result &entry : ranked)
+                    emit(entry.key, entry.count);
+                return true;
+            });
+        if (!written)
+        {
+            Logger::getInstance().log("ERROR: Failed to write output files. Exiting.\n");
+            return 1;
+        }
+
+        Logger::getInstance().log("\n Process complete!\n");
+        Logger::getInstance().log("\n  Top words by count: output.txt\n");
+        return 0;
+    }
+
+    // Multi-process mode: forked workers pull tasks from this process over
+    // Unix domain sockets; failed tasks are re-run, and with resume the tasks
+    // an earlier run finished are skipped
+    size_t workers = worker_process_count();
+    bool resume = resume_enabled();
+    if (workers > 0 || resume)
+    {
+        Coordinator::Options coordinator_options;
+        coordinator_options.workers = workers;
+        coordinator_options.resume = resume;
+        const char *pin = std::getenv("MAPREDUCE_PIN_WORKERS");
+        coordinator_options.pinWorkers = pin != nullptr && std::string(pin) == "1";
+        coordinator_options.kernel = kernel_library.get();
+        Coordinator coordinator(coordinator_options);
+        workers = coordinator.get_options().workers;
+        Logger::getInstance().log("Running with " + std::to_string(workers) + " worker processes" +
+                                  (resume ? ", resuming from the job manifest." : "."));
+        Logger::getInstance().flush();
+        FlatStringMap<uint64_t> reduced;
+        if (!coordinator.run(splits, temp_folder_path, workers, reduced))
+        {
+            Logger::getInstance().log("ERROR: Multi-process run failed. Exiting.\n");
+            return 1;
+        }
+        if (coordinator.resumed_tasks() > 0)
+            Logger::getInstance().log("Skipped " + std::to_string(coordinator.resumed_tasks()) + " tasks finished by an earlier run.");
+        if (coordinator.restarts() > 0)
+            Logger::getInstance().log("Replaced " + std::to_string(coordinator.restarts()) + " failed worker processes.");
+
+        if (!FileHandler::write_output(output_folder_path + "/output.txt", reduced) ||
+            !FileHandler::write_summed_output(output_folder_path + "/output_summed.txt", reduced))
+        {
+            Logger::getInstance().log("ERROR: Failed to write output files. Exiting.\n");
+            return 1;
+        }
+
+        Logger::getInstance().log("\n Process complete!\n");
+        Logger::getInstance().log("\n  Word counts: output.txt\n");
+        Logger::getInstance().log("\n Summed counts: output_summed.txt\n");
+        return 0;
     }
 
+    // Pipelined mode: map and reduce run concurrently over bounded queues
+    // and no spill files are written
+    if (pipeline_mode_enabled())
+    {
+        Logger::getInstance().log("Running in pipelined mode.");
+        FlatStringMap<uint64_t> reduced;
+        Pipeline pipeline;
+        if (!pipeline.run(splits, reduced))
+        {
+            Logger::getInstance().log("ERROR: Pipelined run failed. Exiting.\n");
+            return 1;
+        }
+
+        if (!FileHandler::write_output(output_folder_path + "/output.txt", reduced) ||
+            !FileHandler::write_summed_output(output_folder_path + "/output_summed.txt", reduced))
+        {
+            Logger::getInstance().log("ERROR: Failed to write output files. Exiting.\n");
+            return 1;
+        }
+
+        Logger::getInstance().log("\n Process complete!\n");
+        Logger::getInstance().log("\n  Word counts: output.txt\n");
+        Logger::getInstance().log("\n Summed counts: output_summed.txt\n");
+        return 0;
+    }
+
+    std::vector<std::string> reduce_inputs;
+    uintmax_t spill_bytes = 0;
+    bool incremental = incremental_mode_enabled();
+    if (incremental)
+    {
+        // Incremental mode: unchanged files keep their cached partial counts
+        // and the reducers merge those of every input file
+        ResultCache cache(temp_folder_path + "/result_cache");
+        if (!cache.update(input_paths))
+        {
+            Logger::getInstance().log("ERROR: Failed to update the result cache. Exiting.\n");
+            return 1;
+        }
+        Logger::getInstance().log("Result cache: reused " + std::to_string(cache.reused_files()) + " files, mapped " +
+                                  std::to_string(cache.mapped_files()) + ".");
+        reduce_inputs = cache.partial_paths();
+        spill_bytes = cache.raw_bytes();
+    }
+    else
+    {
+        // Keys are hash-partitioned into one spill file per reduce task,
+        // several per worker so an expensive partition does not hold up the
+        // phase
+        size_t num_partitions = ThreadPool::getInstance().size() * kReducePartitionsPerWorker;
+        PartitionedSpill spill(PartitionedSpill::spill_paths(temp_folder_path + "/mapped_temp", num_partitions));
+        // Keys that would overload one reducer are spread over several; only
+        // safe for the built-in (summing) reduce
+        if (kernel_library.get() == nullptr)
+            spill.enable_hot_key_splitting();
+        else
+            Logger::getInstance().log("Hot-key splitting is off: the kernel's reduce must see every value of a key at once.");
+        Mapper mapper;
+        mapper.set_kernel(kernel_library.get());
+        if (!mapper.map_splits(splits, spill))
+        {
+            Logger::getInstance().log("ERROR: Map phase failed. Exiting.\n");
+            return 1;
+        }
+        std::vector<std::string> hot_keys = spill.hot_keys();
+        if (!hot_keys.empty())
+            Logger::getInstance().log("Spread " + std::to_string(hot_keys.size()) + " hot keys (e.g. '" + hot_keys.front() +
+                                      "') over " + std::to_string(spill.hot_key_fanout()) + " partitions each.");
+        reduce_inputs = spill.paths();
+        spill_bytes = spill.raw_bytes();
+    }
+
+    // Reduce phase: each reducer merges its own partition. When the spill
+    // data would not fit in the reduce memory budget, reducers sort bounded
+    // runs to the temp folder and the merged result is streamed to disk.
+    size_t reduce_memory_budget = reduce_memory_budget_bytes();
+    uintmax_t stored_bytes = 0;
+    for (const std::string &spill_path : reduce_inputs)
+    {
+        std::error_code ec;
+        uintmax_t size = fs::file_size(spill_path, ec);
+        stored_bytes += ec ? 0 : size;
+    }
+    Logger::getInstance().log("Spilled " + std::to_string(spill_bytes) + " record bytes as " +
+                              std::to_string(stored_bytes) + " bytes on disk.");
+
+    std::string output_file_path = output_folder_path + "/output.txt";
     std::string summed_output_path = output_folder_path + "/output_summed.txt";
-    if (!FileHandler::write_summed_output(summed_output_path, reducer.get_reduced_data()))
+    Reducer reducer;
+    reducer.set_kernel(kernel_library.get());
+
+    // An in-memory table costs several times the bytes of its spill records.
+    // The external sort only sums counts, so kernels always reduce in memory.
+    bool over_budget = spill_bytes * kTableBytesPerSpillByte > reduce_memory_budget;
+    if (over_budget && kernel_library.get() != nullptr)
+        Logger::getInstance().log("Spill data (" + std::to_string(spill_bytes) + " bytes) exceeds the reduce memory budget, "
+                                  "but the kernel's reduce runs in memory; external merge sort is not used.");
+    if (over_budget && kernel_library.get() == nullptr)
     {
-        Logger::getInstance().log("ERROR: Failed to write summed output file. Exiting.\n");
-        return 1;
+        Logger::getInstance().log("Spill data (" + std::to_string(spill_bytes) + " bytes) exceeds the reduce memory budget; using external merge sort.");
+        bool written = FileHandler::write_outputs_streamed(output_file_path, summed_output_path,
+            [&](auto &&emit) {
+                return reducer.reduce_external(reduce_inputs, temp_folder_path, reduce_memory_budget, emit);
+            });
+        if (!written)
+        {
+            Logger::getInstance().log("ERROR: External reduce failed. Exiting.\n");
+            return 1;
+        }
+    }
+    else
+    {
+        if (!reducer.reduce_partitions(reduce_inputs))
+        {
+            Logger::getInstance().log("ERROR: Failed to read mapped data. Exiting.\n");
+            return 1;
+        }
+
+        // Write outputs
+        if (!FileHandler::write_output(output_file_path, reducer.get_reduced_data()))
+        {
+            Logger::getInstance().log("ERROR: Failed to write output file. Exiting.\n");
+            return 1;
+        }
+
+        if (!FileHandler::write_summed_output(summed_output_path, reducer.get_reduced_data()))
+        {
+            Logger::getInstance().log("ERROR: Failed to write summed output file. Exiting.\n");
+            return 1;
+        }
     }
 
     // Display results
     Logger::getInstance().log("\n Process complete!\n");
-    Logger::getInstance().log("  Mapped data: mapped_temp.txt\n");
+    Logger::getInstance().log(incremental ? "  Mapped data: result_cache/partial_<file>_<split>.bin\n"
+                                          : "  Mapped data: mapped_temp_<partition>.bin\n");
     Logger::getInstance().log("\n  Word counts: output.txt\n");
     Logger::getInstance().log("\n Summed counts: output_summed.txt\n");
 